@@ -146,18 +146,26 @@ def main(args):
 
     doc = "\n//Extension Method, returns 0 when the extension exist\n"
     impl += doc; head += doc
-    for key, t in type_map.items():
+    # The output and the inputs have the same type except for the real-to-complex and complex-to-real
+    # transforms (e.g. FFTW), which have a real and a complex type
+    ext_types = [(key, key) for key in type_map.keys()]
+    ext_types += [('BH_COMPLEX64', 'BH_FLOAT32'), ('BH_FLOAT32', 'BH_COMPLEX64'),
+                  ('BH_COMPLEX128', 'BH_FLOAT64'), ('BH_FLOAT64', 'BH_COMPLEX128')]
+    for (out_key, in_key) in ext_types:
+        t = {'out_name': type_map[out_key]['name'], 'out_cpp': type_map[out_key]['cpp'],
+             'out_bhc_ary': type_map[out_key]['bhc_ary'], 'in_name': type_map[in_key]['name'],
+             'in_cpp': type_map[in_key]['cpp'], 'in_bhc_ary': type_map[in_key]['bhc_ary']}
         decl = "int bhc_extmethod"
-        decl += "_A%(name)s_A%(name)s_A%(name)s"%t
-        decl += "(const char *name, %(bhc_ary)s out, const %(bhc_ary)s in1, const %(bhc_ary)s in2)"%t
+        decl += "_A%(out_name)s_A%(in_name)s_A%(in_name)s"%t
+        decl += "(const char *name, %(out_bhc_ary)s out, const %(in_bhc_ary)s in1, const %(in_bhc_ary)s in2)"%t
         head += "DLLEXPORT %s;\n"%decl
         impl += "%s"%decl
         impl += """
 {
     try{
-        bhxx::Runtime::instance().enqueue_extmethod(name, *((bhxx::BhArray<%(cpp)s>*) out),
-                                                          *((bhxx::BhArray<%(cpp)s>*) in1),
-                                                          *((bhxx::BhArray<%(cpp)s>*) in2));
+        bhxx::Runtime::instance().enqueue_extmethod(name, *((bhxx::BhArray<%(out_cpp)s>*) out),
+                                                          *((bhxx::BhArray<%(in_cpp)s>*) in1),
+                                                          *((bhxx::BhArray<%(in_cpp)s>*) in2));
     }catch (... ){
         return -1;
     }
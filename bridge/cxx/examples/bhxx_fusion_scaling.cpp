@@ -0,0 +1,67 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A synthetic benchmark of the fusion time of huge flushes such as unrolled loops. Each iteration
+// emits four instructions on two array sizes, which the fusers must untangle. Compare the fusers through the
+// environment and read the fusion time of the profiling output, e.g.
+//   BH_OPENMP_PROF=true BH_OPENMP_FUSER_LIST=greedy ./bhxx_fusion_scaling 1000
+//   BH_OPENMP_PROF=true BH_OPENMP_FUSER_LIST=greedy_reachability BH_OPENMP_FUSER_WINDOW=0 ./bhxx_fusion_scaling 10000
+// Usage: bhxx_fusion_scaling [ninstr] [nelem]
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+#include <bhxx/bhxx.hpp>
+
+using namespace bhxx;
+using namespace std;
+
+void compute(uint64_t ninstr, uint64_t nelem) {
+    BhArray<double> a({nelem}), b({nelem}), c({nelem / 2}), d({nelem / 2});
+    identity(a, 1.0);
+    identity(b, 2.0);
+    identity(c, 3.0);
+    identity(d, 4.0);
+    Runtime::instance().flush();
+
+    const auto begin = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ninstr / 4; ++i) {
+        add(a, a, b);
+        multiply(c, c, 0.5);
+        multiply(b, b, 0.5);
+        add(d, d, c);
+    }
+    Runtime::instance().flush();
+    const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    BhArray<double> checksum({1});
+    add_reduce(checksum, a, 0);
+    cout << "checksum: " << checksum << endl;
+    cout << "flush of " << ninstr << " instructions: " << elapsed << " sec" << endl;
+    Runtime::instance().flush();
+}
+
+int main(int argc, char *argv[]) {
+    const uint64_t ninstr = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000;
+    const uint64_t nelem = argc > 2 ? strtoull(argv[2], nullptr, 10) : 1000;
+    compute(ninstr, nelem);
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A synthetic gather/scatter benchmark: a KNN-style gather of random neighbours and a histogram-style
+// scatter with many duplicated indexes. Compare the code generation options through the environment, e.g.
+//   BH_OPENMP_PREFETCH_DISTANCE=0 ./bhxx_gather_scatter
+//   BH_OPENMP_SCATTER_SORT=true ./bhxx_gather_scatter
+// Usage: bhxx_gather_scatter [nelem] [nbins] [repeats]
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+#include <bhxx/bhxx.hpp>
+
+using namespace bhxx;
+using namespace std;
+
+namespace {
+double seconds_since(const chrono::steady_clock::time_point &begin) {
+    return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+}
+
+void compute(uint64_t nelem, uint64_t nbins, int repeats) {
+    // The table we gather from and scatter into a histogram
+    BhArray<uint64_t> rand({nelem});
+    random(rand, 42, 1);
+    BhArray<double> table({nelem});
+    identity(table, rand);
+
+    // Random neighbours: every element points to an arbitrary element in the table
+    BhArray<uint64_t> neighbours({nelem});
+    random(neighbours, 42, 2);
+    mod(neighbours, neighbours, nelem);
+
+    // Random bins: `nelem` indexes into `nbins` bins, thus many duplicated indexes
+    BhArray<uint64_t> bins({nelem});
+    random(bins, 42, 3);
+    mod(bins, bins, nbins);
+
+    BhArray<double> gathered({nelem});
+    BhArray<double> hist({nbins});
+    identity(hist, 0.0);
+    Runtime::instance().flush();
+
+    // NB: the first iteration includes the JIT compilation, which we exclude from the timing
+    double gather_time = 0, scatter_time = 0;
+    for (int i = 0; i <= repeats; ++i) {
+        auto begin = chrono::steady_clock::now();
+        gather(gathered, table, neighbours);
+        Runtime::instance().flush();
+        if (i > 0) {
+            gather_time += seconds_since(begin);
+        }
+
+        begin = chrono::steady_clock::now();
+        scatter(hist, table, bins);
+        Runtime::instance().flush();
+        if (i > 0) {
+            scatter_time += seconds_since(begin);
+        }
+    }
+
+    BhArray<double> checksum({1});
+    add_reduce(checksum, gathered, 0);
+    cout << "checksum: " << checksum << endl;
+    cout << "gather:  " << gather_time / repeats << " sec" << endl;
+    cout << "scatter: " << scatter_time / repeats << " sec" << endl;
+    Runtime::instance().flush();
+}
+
+int main(int argc, char *argv[]) {
+    const uint64_t nelem = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+    const uint64_t nbins = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100000;
+    const int repeats = argc > 3 ? atoi(argv[3]) : 5;
+    compute(nelem, nbins, repeats);
+    return 0;
+}
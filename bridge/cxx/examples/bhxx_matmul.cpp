@@ -0,0 +1,78 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A matrix product written NumPy-style as a broadcasted multiplication followed by a sum, i.e.
+// `sum(a[:, :, None] * b[None, :, :], axis=1)`. Compare the BLAS rewrite of the BCCON filter with the JIT loop:
+//   BH_BCCON_MATMUL=false ./bhxx_matmul
+// Usage: bhxx_matmul [n] [repeats]
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+#include <bhxx/bhxx.hpp>
+
+using namespace bhxx;
+using namespace std;
+
+void compute(uint64_t n, int repeats) {
+    BhArray<double> a({n, n}), b({n, n}), c({n, n});
+    {
+        BhArray<uint64_t> rand({n, n});
+        random(rand, 42, 1);
+        identity(a, rand);
+        random(rand, 42, 2);
+        identity(b, rand);
+        divide(a, a, 1e19);
+        divide(b, b, 1e19);
+    }
+    // The broadcasted views `a[:, :, None]` and `b[None, :, :]`
+    BhArray<double> a_view(a.base, {n, n, n}, {static_cast<int64_t>(n), 1, 0});
+    BhArray<double> b_view(b.base, {n, n, n}, {0, static_cast<int64_t>(n), 1});
+    Runtime::instance().flush();
+
+    // NB: the first iteration includes the JIT compilation, which we exclude from the timing
+    double elapsed = 0;
+    for (int i = 0; i <= repeats; ++i) {
+        const auto begin = chrono::steady_clock::now();
+        {
+            BhArray<double> t({n, n, n});
+            multiply(t, a_view, b_view);
+            add_reduce(c, t, 1);
+        }
+        Runtime::instance().flush();
+        if (i > 0) {
+            elapsed += chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        }
+    }
+
+    BhArray<double> checksum({1}), flat(c.base, {n * n});
+    add_reduce(checksum, flat, 0);
+    cout << "checksum: " << checksum << endl;
+    cout << "matmul: " << elapsed / repeats << " sec" << endl;
+    Runtime::instance().flush();
+}
+
+int main(int argc, char *argv[]) {
+    const uint64_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 500;
+    const int repeats = argc > 2 ? atoi(argv[2]) : 3;
+    compute(n, repeats);
+    return 0;
+}
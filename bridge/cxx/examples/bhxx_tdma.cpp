@@ -0,0 +1,84 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A batch of diagonally dominant tridiagonal systems solved by the `tdma` extension method as in an ADI-style
+// solver, which calls it every time step. The systems are either stored row by row or interleaved such that
+// element `i` of all systems is contiguous.
+// Usage: bhxx_tdma [nsystems] [system size] [repeats] [interleaved (0 or 1)] [float32 (0 or 1)]
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+#include <bhxx/bhxx.hpp>
+
+using namespace bhxx;
+using namespace std;
+
+template<typename T>
+void compute(uint64_t m, uint64_t n, int repeats, bool interleaved) {
+    // The diagonals and the right-hand side as views of the (3, m, n) systems either way
+    const int64_t m_ = static_cast<int64_t>(m), n_ = static_cast<int64_t>(n);
+    const Stride diag_stride = interleaved ? Stride{m_ * n_, 1, m_} : Stride{m_ * n_, n_, 1};
+    const Stride stride = interleaved ? Stride{1, m_} : Stride{n_, 1};
+    BhArray<T> diagonals({3, m, n}, diag_stride), rhs({m, n}, stride), out({m, n}, stride);
+    {
+        BhArray<uint64_t> rand({3, m, n});
+        random(rand, 42, 1);
+        mod(rand, rand, 1000);
+        identity(diagonals, rand);
+        multiply(diagonals, diagonals, static_cast<T>(1e-3));
+        BhArray<T> b(diagonals.base, {m, n}, {diag_stride[1], diag_stride[2]}, static_cast<size_t>(m_ * n_));
+        add(b, b, static_cast<T>(4));
+        identity(rhs, static_cast<T>(1));
+    }
+    Runtime::instance().flush();
+
+    // NB: the first iteration includes the allocations, which we exclude from the timing
+    double elapsed = 0;
+    for (int i = 0; i <= repeats; ++i) {
+        auto begin = chrono::steady_clock::now();
+        Runtime::instance().enqueue_extmethod("tdma", out, diagonals, rhs);
+        Runtime::instance().flush();
+        if (i > 0) {
+            elapsed += chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        }
+    }
+
+    BhArray<T> checksum({1});
+    BhArray<T> flat(out.base, {m * n});
+    add_reduce(checksum, flat, 0);
+    cout << "checksum: " << checksum << endl;
+    cout << "tdma: " << elapsed / repeats << " sec" << endl;
+    Runtime::instance().flush();
+}
+
+int main(int argc, char *argv[]) {
+    const uint64_t m = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+    const uint64_t n = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100;
+    const int repeats = argc > 3 ? atoi(argv[3]) : 10;
+    const bool interleaved = argc > 4 and atoi(argv[4]) != 0;
+    if (argc > 5 and atoi(argv[5]) != 0) {
+        compute<float>(m, n, repeats, interleaved);
+    } else {
+        compute<double>(m, n, repeats, interleaved);
+    }
+    return 0;
+}
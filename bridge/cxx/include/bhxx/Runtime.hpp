@@ -53,10 +53,11 @@ class Runtime {
     // We have to handle random specially because of the `BH_R123` scalar type
     void enqueue_random(BhArray<uint64_t>& out, uint64_t seed, uint64_t key);
 
-    // Enqueue an extension method
-    template <typename T>
-    void enqueue_extmethod(const std::string& name, BhArray<T>& out, BhArray<T>& in1,
-                           BhArray<T>& in2);
+    // Enqueue an extension method. The operand types might differ, e.g. the real input and complex output of
+    // a real-to-complex FFT.
+    template <typename TO, typename TI1, typename TI2>
+    void enqueue_extmethod(const std::string& name, BhArray<TO>& out, BhArray<TI1>& in1,
+                           BhArray<TI2>& in2);
 
     /** Schedule a base object for deletion
      *
@@ -168,9 +169,9 @@ void Runtime::enqueue(bh_opcode opcode, T& op, Ts&... ops) {
     }
 }
 
-template <typename T>
-void Runtime::enqueue_extmethod(const std::string& name, BhArray<T>& out, BhArray<T>& in1,
-                                BhArray<T>& in2) {
+template <typename TO, typename TI1, typename TI2>
+void Runtime::enqueue_extmethod(const std::string& name, BhArray<TO>& out, BhArray<TI1>& in1,
+                                BhArray<TI2>& in2) {
     bh_opcode opcode;
 
     // Look for the extension opcode
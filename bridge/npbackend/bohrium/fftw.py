@@ -0,0 +1,42 @@
+"""
+Fastest Fourier Transform in the West (FFTW)
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Utilize the real-to-complex and complex-to-real transforms of FFTW directly from Python
+"""
+
+import bohrium as np
+from . import ufuncs
+
+
+def rfftn(a):
+    """ The n-dimensional FFT of the real array 'a' over all axes, like numpy.fft.rfftn().
+    The result is complex64 when 'a' is float32 and complex128 otherwise. """
+    if a.dtype == np.float32:
+        out_type = np.complex64
+    else:
+        out_type = np.complex128
+        a = a.astype(np.float64)
+
+    out = np.empty(shape=a.shape[:-1] + (a.shape[-1] // 2 + 1,), dtype=out_type)
+    # NB: the extension method ignores the second input
+    ufuncs.extmethod("fftw_r2c", out, a, a)
+    return out
+
+
+def irfftn(a, n=None):
+    """ The inverse of rfftn() over all axes, like numpy.fft.irfftn().
+    'n' is the length of the last axis of the output, which defaults to 2 * (a.shape[-1] - 1). """
+    if n is None:
+        n = 2 * (a.shape[-1] - 1)
+    if a.dtype == np.complex64:
+        out_type = np.float32
+    else:
+        out_type = np.float64
+        a = a.astype(np.complex128)
+
+    out = np.empty(shape=a.shape[:-1] + (n,), dtype=out_type)
+    # NB: the extension method ignores the second input
+    ufuncs.extmethod("fftw_c2r", out, a, a)
+    # FFTW doesn't normalize the transforms
+    out /= out.size
+    return out
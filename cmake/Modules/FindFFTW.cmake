@@ -4,6 +4,7 @@
 #  FFTW_INCLUDES    - where to find fftw3.h
 #  FFTW_LIBRARIES   - List of libraries when using FFTW.
 #  FFTW_FOUND       - True if FFTW found.
+#  FFTW_FLOAT_FOUND - True if the single-precision FFTW (fftw3f) is also found and part of FFTW_LIBRARIES.
 
 include (FindPackageHandleStandardArgs)
 
@@ -14,6 +15,10 @@ endif (FFTW_INCLUDES)
 
 find_path (FFTW_INCLUDES_PRE fftw3.h)
 find_library (FFTW_LIBRARIES_PRE NAMES fftw3)
+# The single-precision and the threaded libraries (the latter are part of fftw3 in some distributions)
+find_library (FFTWF_LIBRARIES_PRE NAMES fftw3f)
+find_library (FFTW_THREADS_LIBRARIES_PRE NAMES fftw3_threads)
+find_library (FFTWF_THREADS_LIBRARIES_PRE NAMES fftw3f_threads)
 
 # handle the QUIETLY and REQUIRED arguments and set FFTW_FOUND to TRUE if
 # all listed variables are TRUE
@@ -22,8 +27,23 @@ if (APPLE AND FFTW_INCLUDES_PRE)
 else ()
     set (FFTW_INCLUDES ${FFTW_INCLUDES_PRE})
     set (FFTW_LIBRARIES ${FFTW_LIBRARIES_PRE})
+    set (FFTW_FLOAT_FOUND FALSE)
+    # The extra libraries are only of use together with fftw3
+    if (FFTW_LIBRARIES_PRE)
+        if (FFTW_THREADS_LIBRARIES_PRE)
+            set (FFTW_LIBRARIES ${FFTW_THREADS_LIBRARIES_PRE} ${FFTW_LIBRARIES})
+        endif ()
+        if (FFTWF_LIBRARIES_PRE)
+            set (FFTW_FLOAT_FOUND TRUE)
+            set (FFTW_LIBRARIES ${FFTWF_LIBRARIES_PRE} ${FFTW_LIBRARIES})
+            if (FFTWF_THREADS_LIBRARIES_PRE)
+                set (FFTW_LIBRARIES ${FFTWF_THREADS_LIBRARIES_PRE} ${FFTW_LIBRARIES})
+            endif ()
+        endif ()
+    endif ()
 endif ()
 
 find_package_handle_standard_args (FFTW DEFAULT_MSG FFTW_LIBRARIES FFTW_INCLUDES)
 
-mark_as_advanced (FFTW_LIBRARIES_PRE FFTW_INCLUDES_PRE)
+mark_as_advanced (FFTW_LIBRARIES_PRE FFTWF_LIBRARIES_PRE FFTW_THREADS_LIBRARIES_PRE FFTWF_THREADS_LIBRARIES_PRE
+                  FFTW_INCLUDES_PRE)
@@ -118,6 +118,37 @@ void bh_data_malloc(bh_base* base)
     }
 }
 
+/* Allocate zero initialized data memory for the given base if not already allocated.
+ * For convenience, the base is allowed to be NULL.
+ *
+ * @base    The base in question
+ */
+void bh_data_calloc(bh_base* base)
+{
+    int64_t bytes;
+
+    if(base == NULL) return;
+    if(base->data != NULL) return;
+
+    bytes = bh_base_size(base);
+
+    // We allow zero sized arrays.
+    if(bytes == 0) return;
+
+    if(bytes < 0) {
+        throw runtime_error("Cannot allocate less than zero bytes.");
+    }
+
+    base->data = bh_memory_calloc(bytes);
+
+    if(base->data == NULL) {
+        stringstream ss;
+        ss << "bh_data_calloc() could not allocate a data region. " \
+           << "Returned error code: " << strerror(errno);
+        throw runtime_error(ss.str());
+    }
+}
+
 /* Frees data memory for the given view.
  * For convenience, the view is allowed to be NULL.
  *
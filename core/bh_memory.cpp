@@ -24,6 +24,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <sys/mman.h>
 #endif
 #include <cstddef>
+#include <cstring>
 
 #include <bh_memory.h>
 #include <bh_win.h>
@@ -50,6 +51,24 @@ void* bh_memory_malloc(int64_t size)
 #endif
 }
 
+/* Allocate an alligned contigous block of zero initialized memory.
+ * Anonymous mmap pages are already zero thus the memory isn't touched
+ *
+ * @size  The size of the allocated block
+ * @return A pointer to data, and NULL on error
+ */
+void* bh_memory_calloc(int64_t size)
+{
+#ifdef _WIN32
+    void *data = _aligned_malloc(size, 16);
+    if (data != NULL)
+        memset(data, 0, size);
+    return data;
+#else
+    return bh_memory_malloc(size);
+#endif
+}
+
 /* Frees a previously allocated data block
  *
  * @data  The pointer returned from a call to bh_memory_malloc
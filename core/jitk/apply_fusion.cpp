@@ -35,6 +35,8 @@ vector<Block> apply_pre_fusion(const vector<bh_instruction*> &instr_list,
         return fuser_singleton(instr_list);
     } else if (transformer_name == "pre_fuser_lossy"){
         return pre_fuser_lossy(instr_list);
+    } else if (transformer_name == "pre_fuser_reorder"){
+        return pre_fuser_reorder(instr_list);
     } else {
         cout << "Unknown pre-fuser: \"" <<  transformer_name << "\"" << endl;
         throw runtime_error("Unknown pre-fuser!");
@@ -42,11 +44,13 @@ vector<Block> apply_pre_fusion(const vector<bh_instruction*> &instr_list,
 }
 
 void apply_transformers(vector<Block> &block_list, const vector<string> &transformer_names,
-                        bool avoid_rank0_sweep) {
+                        bool avoid_rank0_sweep, uint64_t fuser_window) {
 
     for(auto it = transformer_names.begin(); it != transformer_names.end(); ++it) {
         if (*it == "push_reductions_inwards") {
             push_reductions_inwards(block_list);
+        } else if (*it == "interchange_for_locality") {
+            interchange_for_locality(block_list);
         } else if (*it == "split_for_threading") {
             split_for_threading(block_list);
         } else if (*it == "collapse_redundant_axes") {
@@ -59,6 +63,8 @@ void apply_transformers(vector<Block> &block_list, const vector<string> &transfo
             fuser_reshapable_first(block_list, avoid_rank0_sweep);
         } else if (*it == "greedy") {
             fuser_greedy(block_list, avoid_rank0_sweep);
+        } else if (*it == "greedy_reachability") {
+            fuser_greedy_reachability(block_list, avoid_rank0_sweep, fuser_window);
         } else {
             cout << "Unknown transformer: \"" << *it << "\"" << endl;
             throw runtime_error("Unknown transformer!");
@@ -89,7 +95,8 @@ vector<Block> get_block_list(const vector<bh_instruction*> &instr_list, const Co
         const auto tfusion = chrono::steady_clock::now();
         stat.time_pre_fusion += tfusion - tpre_fusion;
         // Then we fuse fully
-        apply_transformers(block_list, config.defaultGetList("fuser_list", {"greedy"}), avoid_rank0_sweep);
+        apply_transformers(block_list, config.defaultGetList("fuser_list", {"greedy"}), avoid_rank0_sweep,
+                           config.defaultGet<uint64_t>("fuser_window", 0));
         stat.time_fusion += chrono::steady_clock::now() - tfusion;
         fcache.insert(instr_list, block_list);
     }
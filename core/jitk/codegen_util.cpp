@@ -18,8 +18,11 @@ GNU Lesser General Public License along with Bohrium.
 If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <limits>
 #include <iomanip>
+#include <cstdlib>
+#include <cstring>
 #include <boost/filesystem/operations.hpp>
 #include <jitk/codegen_util.hpp>
 #include <jitk/view.hpp>
@@ -41,6 +44,68 @@ bool sweeping_innermost_axis(InstrPtr instr) {
     assert(instr->operand.size() == 3);
     return instr->sweep_axis() == instr->operand[1].ndim - 1;
 }
+
+// Find sliding windows along the innermost loop of 'block', which is a set of read-only views that
+// only differ by their offset and where the offsets are consecutive multiples of the innermost stride.
+// E.g. a[i-1], a[i], and a[i+1] is a window of size three.
+// Each returned window is ordered by the views' offsets, thus the view that reaches an element first is last.
+// NB: 'ignore_bases' are the bases written within 'block'.
+vector<vector<const bh_view*> > find_sliding_windows(const LoopB &block, const Scope *parent_scope,
+                                                      const set<bh_base*> &ignore_bases) {
+    constexpr int64_t MAX_WINDOW_SIZE = 9;
+    const int axis = block.rank;
+
+    // A window is identified by its base, shape, strides, and the offset modulo the innermost stride
+    // and then mapped to the views' offsets in number of iterations
+    map<vector<int64_t>, map<int64_t, const bh_view*> > candidates;
+    const set<bh_base *> local_tmps = block.getLocalTemps();
+    for (const InstrPtr &instr: block.getLocalInstr()) {
+        for (size_t i = 1; i < instr->operand.size(); ++i) {
+            const bh_view &view = instr->operand[i];
+            if (bh_is_constant(&view) or ignore_bases.find(view.base) != ignore_bases.end() or
+                local_tmps.find(view.base) != local_tmps.end()) {
+                continue;
+            }
+            // NB: a view that a parent scalar replaces but haven't declared yet, will be declared in this block
+            if (parent_scope != nullptr and not parent_scope->isArray(view) and
+                not (parent_scope->isScalarReplaced_R(view) and not parent_scope->isDeclared(view))) {
+                continue;
+            }
+            if (view.ndim != axis+1 or view.stride[axis] == 0) {
+                continue;
+            }
+            const int64_t stride = view.stride[axis];
+            const int64_t abs_stride = std::abs(stride);
+            const int64_t residue = view.start % abs_stride;
+            vector<int64_t> key = {reinterpret_cast<int64_t>(view.base), residue};
+            key.insert(key.end(), view.shape, view.shape + view.ndim);
+            key.insert(key.end(), view.stride, view.stride + view.ndim);
+            // NB: 'candidates[key]' is ordered by the offset in number of iterations
+            const int64_t offset = (view.start - residue) / abs_stride * (stride > 0 ? 1 : -1);
+            candidates[key].insert(make_pair(offset, &view));
+        }
+    }
+    vector<vector<const bh_view*> > ret;
+    for (const auto &cand: candidates) {
+        vector<const bh_view*> window;
+        int64_t prev = 0;
+        for (const auto &offset_and_view: cand.second) {
+            if (window.empty() or offset_and_view.first != prev+1 or
+                static_cast<int64_t>(window.size()) == MAX_WINDOW_SIZE) {
+                if (window.size() > 1) {
+                    ret.push_back(window);
+                }
+                window.clear();
+            }
+            window.push_back(offset_and_view.second);
+            prev = offset_and_view.first;
+        }
+        if (window.size() > 1) {
+            ret.push_back(window);
+        }
+    }
+    return ret;
+}
 }
 
 
@@ -171,7 +236,14 @@ void write_loop_block(const SymbolTable &symbols,
                                           bool loop_is_peeled,
                                           const std::vector<const LoopB *> &threaded_blocks,
                                           std::stringstream &out)> head_writer,
-                      std::stringstream &out) {
+                      std::stringstream &out,
+                      std::function<void (const SymbolTable &symbols,
+                                          Scope &scope,
+                                          const LoopB &block,
+                                          const ConfigParser &config,
+                                          bool loop_is_peeled,
+                                          const std::vector<const LoopB *> &threaded_blocks,
+                                          std::stringstream &out)> tail_writer) {
 
     if (block.isSystemOnly()) {
         out << "// Removed loop with only system instructions\n";
@@ -195,6 +267,8 @@ void write_loop_block(const SymbolTable &symbols,
 
     // Let's scalar replace input-only arrays that are used multiple times
     vector<const bh_view*> scalar_replaced_input_only;
+    // And the sliding windows of input-only arrays that we load using rotating registers
+    vector<vector<const bh_view*> > sliding_windows;
     {
         const vector<InstrPtr> block_instr_list = block.getAllInstr();
         // We have to ignore output arrays and arrays that are accumulated
@@ -207,6 +281,17 @@ void write_loop_block(const SymbolTable &symbols,
                 ignore_bases.insert(instr->operand[1].base);
             }
         }
+        // Rotating registers serialize the loop thus we only use them in innermost loops that are never
+        // parallelized i.e. neither the outermost loop nor one of the 'threaded_blocks'
+        if (not opencl and block.rank > 0 and block.isInnermost() and block._sweeps.empty() and
+            std::find_if(threaded_blocks.begin(), threaded_blocks.end(),
+                         [&block](const LoopB* b){return *b == block;}) == threaded_blocks.end() and
+            config.defaultGet<bool>("rotating_registers", false)) {
+            sliding_windows = find_sliding_windows(block, parent_scope, ignore_bases);
+            for (const vector<const bh_view*> &window: sliding_windows) {
+                scalar_replaced_input_only.insert(scalar_replaced_input_only.end(), window.begin(), window.end());
+            }
+        }
         // First we add a valid view to the set of 'candidates' and if we encounter the view again
         // we add it to the 'scalar_replaced_input_only'
         set<bh_view> candidates;
@@ -231,6 +316,30 @@ void write_loop_block(const SymbolTable &symbols,
     Scope scope(symbols, parent_scope, local_tmps, scalar_replaced_reduction_outputs,
                 scalar_replaced_input_only, config);
 
+    // The registers of a sliding window are declared before the for-loop and all but the last register are
+    // loaded in advance. In each iteration, we only load the last register and rotate the registers at the end.
+    for (const vector<const bh_view*> &window: sliding_windows) {
+        for (const bh_view *view: window) {
+            scope.insertRotating(*view);
+            scope.writeDeclaration(*view, type_writer(view->base->type), out);
+            out << "\n";
+            spaces(out, 4 + block.rank * 4);
+        }
+        out << "{ // Load the sliding window of the first iteration\n";
+        spaces(out, 8 + block.rank * 4);
+        out << type_writer(bh_type::UINT64) << " i" << block.rank << " = 0;\n";
+        for (size_t i = 0; i < window.size() - 1; ++i) {
+            spaces(out, 8 + block.rank * 4);
+            scope.getName(*window[i], out);
+            out << " = a" << symbols.baseID(window[i]->base);
+            write_array_subscription(scope, *window[i], out, true);
+            out << ";\n";
+        }
+        spaces(out, 4 + block.rank * 4);
+        out << "}\n";
+        spaces(out, 4 + block.rank * 4);
+    }
+
     // When a reduction output is a scalar (e.g. because of array contraction or scalar replacement),
     // it should be declared before the for-loop
     for (const InstrPtr &instr: block._sweeps) {
@@ -347,7 +456,7 @@ void write_loop_block(const SymbolTable &symbols,
                     write_instr(peeled_scope, *b.getInstr(), out, opencl);
                 }
             } else {
-                write_loop_block(symbols, &peeled_scope, b.getLoop(), config, threaded_blocks, opencl, type_writer, head_writer, out);
+                write_loop_block(symbols, &peeled_scope, b.getLoop(), config, threaded_blocks, opencl, type_writer, head_writer, out, tail_writer);
             }
         }
         spaces(out, 4 + block.rank*4);
@@ -385,6 +494,14 @@ void write_loop_block(const SymbolTable &symbols,
             out << "\n";
         }
     }
+    // Load the last register of each sliding window
+    for (const vector<const bh_view*> &window: sliding_windows) {
+        spaces(out, 8 + block.rank * 4);
+        scope.getName(*window.back(), out);
+        out << " = a" << symbols.baseID(window.back()->base);
+        write_array_subscription(scope, *window.back(), out, true);
+        out << ";\n";
+    }
 
     // Write the for-loop body
     // The body in OpenCL and OpenMP are very similar but OpenMP might need to insert "#pragma omp atomic/critical"
@@ -396,7 +513,7 @@ void write_loop_block(const SymbolTable &symbols,
                     write_instr(scope, *b.getInstr(), out, true);
                 }
             } else {
-                write_loop_block(symbols, &scope, b.getLoop(), config, threaded_blocks, opencl, type_writer, head_writer, out);
+                write_loop_block(symbols, &scope, b.getLoop(), config, threaded_blocks, opencl, type_writer, head_writer, out, tail_writer);
             }
         }
     } else {
@@ -413,16 +530,38 @@ void write_loop_block(const SymbolTable &symbols,
                             out << "#pragma omp critical\n";
                         }
                     }
+                    if (scope.prefetch_distance > 0) {
+                        stringstream ss;
+                        write_prefetch(scope, *instr, ss);
+                        if (not ss.str().empty()) {
+                            spaces(out, 4 + b.rank()*4);
+                            out << ss.str();
+                        }
+                    }
                     spaces(out, 4 + b.rank()*4);
-                    write_instr(scope, *instr, out);
+                    write_instr(scope, *instr, out, false,
+                                instr->operand.size() > 0 and scope.isNontemporal(instr->operand[0]));
                 }
             } else {
-                write_loop_block(symbols, &scope, b.getLoop(), config, threaded_blocks, opencl, type_writer, head_writer, out);
+                write_loop_block(symbols, &scope, b.getLoop(), config, threaded_blocks, opencl, type_writer, head_writer, out, tail_writer);
             }
         }
     }
+    // Rotate the registers of each sliding window
+    for (const vector<const bh_view*> &window: sliding_windows) {
+        for (size_t i = 0; i < window.size() - 1; ++i) {
+            spaces(out, 8 + block.rank * 4);
+            scope.getName(*window[i], out);
+            out << " = ";
+            scope.getName(*window[i+1], out);
+            out << ";\n";
+        }
+    }
     spaces(out, 4 + block.rank*4);
     out << "}\n";
+    if (tail_writer) {
+        tail_writer(symbols, scope, block, config, need_to_peel, threaded_blocks, out);
+    }
 
     // Let's copy the scalar replaced reduction outputs back to the original array
     for (const bh_view *view: scalar_replaced_reduction_outputs) {
@@ -435,19 +574,253 @@ void write_loop_block(const SymbolTable &symbols,
     }
 }
 
+int64_t util_elide_zero_fills(vector<bh_instruction *> &instr_list) {
+    // The arrays accessed or freed in 'instr_list'
+    set<const bh_base*> frees;
+    for (const bh_instruction *instr: instr_list) {
+        if (instr->opcode == BH_FREE) {
+            frees.insert(instr->operand[0].base);
+        }
+    }
+    set<const bh_base*> accessed;
+    int64_t ret = 0;
+    vector<bh_instruction *> new_instr_list;
+    new_instr_list.reserve(instr_list.size());
+    for (bh_instruction *instr: instr_list) {
+        if (instr->opcode == BH_IDENTITY and bh_is_constant(&instr->operand[1])) {
+            const bh_view &view = instr->operand[0];
+            bh_base *base = view.base;
+            // NB: we compare the bytes of the constant since e.g. -0.0 isn't zero bytes
+            const bh_constant_value zero{};
+            const bool is_zero = memcmp(&instr->constant.value, &zero, bh_type_size(instr->constant.type)) == 0;
+            if (is_zero and base->data == nullptr and view.start == 0 and bh_is_contiguous(&view) and
+                bh_nelements(view) == base->nelem and not util::exist(accessed, base) and
+                not util::exist(frees, base)) {
+                bh_data_calloc(base);
+                accessed.insert(base);
+                ++ret;
+                continue;
+            }
+        }
+        for (const bh_view *view: instr->get_views()) {
+            accessed.insert(view->base);
+        }
+        new_instr_list.push_back(instr);
+    }
+    instr_list = std::move(new_instr_list);
+    return ret;
+}
+
+namespace {
+// Returns the rows from 'begin' to 'end' of the matrix 'view'
+bh_view row_slice(const bh_view &view, int64_t begin, int64_t end) {
+    bh_view ret = view;
+    ret.start += begin * view.stride[0];
+    ret.shape[0] = end - begin;
+    return ret;
+}
+
+// Returns the end of the epilogue of the BLAS gemm at 'instr_list[pc]', which is the element-wise instructions
+// following the gemm that access matrices of the output shape through the same views as the gemm output.
+// Thus, each row tile of the epilogue only accesses the same row tile of the output.
+size_t gemm_epilogue_end(const vector<bh_instruction> &instr_list, size_t pc) {
+    const bh_instruction &gemm = instr_list[pc];
+    const bh_view &C = gemm.operand[0];
+    // The first view of each array the gemm and the epilogue access and the arrays they write
+    map<const bh_base *, bh_view> accessed = {{C.base, C}};
+    set<const bh_base *> written = {C.base};
+    size_t ret = pc + 1;
+    for (size_t i = pc + 1; i < instr_list.size(); ++i) {
+        const bh_instruction &instr = instr_list[i];
+        if (instr.opcode == BH_FREE or instr.opcode == BH_NONE) {
+            continue;
+        }
+        if (not bh_opcode_is_elementwise(instr.opcode)) {
+            break;
+        }
+        const bh_base *out = instr.operand[0].base;
+        bool fits = out != gemm.operand[1].base and out != gemm.operand[2].base;
+        for (const bh_view &view: instr.operand) {
+            if (bh_is_constant(&view)) {
+                continue;
+            }
+            if (view.ndim != 2 or view.shape[0] != C.shape[0] or view.shape[1] != C.shape[1]) {
+                fits = false;
+            }
+            auto it = accessed.find(view.base);
+            if (it != accessed.end() and not (it->second == view) and
+                (util::exist(written, view.base) or view.base == out)) {
+                fits = false;
+            }
+        }
+        if (not fits) {
+            break;
+        }
+        for (const bh_view &view: instr.operand) {
+            if (not bh_is_constant(&view)) {
+                accessed.insert(make_pair(view.base, view));
+            }
+        }
+        written.insert(out);
+        ret = i + 1;
+    }
+    return ret;
+}
+
+// Execute the BLAS gemm 'instr_list[pc]' and its epilogue, which ends at 'end', one row tile of the output at a
+// time such that the epilogue reads the output tile while it is still in cache. The frees of arrays that the
+// epilogue creates are applied to each tile, which lets the engine contract them. The rest of the frees are
+// returned.
+vector<bh_instruction> execute_gemm_tiled(component::ComponentImpl *self, extmethod::ExtmethodFace &gemm_impl,
+                                          const vector<bh_instruction> &instr_list, size_t pc, size_t end,
+                                          int64_t tile_rows) {
+    const bh_instruction &gemm = instr_list[pc];
+    // The arrays the epilogue writes before accessing otherwise
+    set<const bh_base *> created, accessed;
+    vector<bh_instruction> frees;
+    for (size_t i = pc + 1; i < end; ++i) {
+        const bh_instruction &instr = instr_list[i];
+        if (instr.opcode == BH_FREE and not util::exist(created, instr.operand[0].base)) {
+            frees.push_back(instr);
+        } else if (instr.opcode != BH_FREE and instr.opcode != BH_NONE) {
+            if (not util::exist(accessed, instr.operand[0].base) and instr.operand[0].base->data == nullptr) {
+                created.insert(instr.operand[0].base);
+            }
+            for (const bh_view &view: instr.operand) {
+                if (not bh_is_constant(&view)) {
+                    accessed.insert(view.base);
+                }
+            }
+        }
+    }
+    const int64_t nrows = gemm.operand[0].shape[0];
+    for (int64_t begin = 0; begin < nrows; begin += tile_rows) {
+        const int64_t tile_end = std::min(nrows, begin + tile_rows);
+        bh_instruction tile_gemm = gemm;
+        tile_gemm.operand[0] = row_slice(gemm.operand[0], begin, tile_end);
+        tile_gemm.operand[1] = row_slice(gemm.operand[1], begin, tile_end);
+        gemm_impl.execute(&tile_gemm, nullptr);
+
+        bh_ir epilogue;
+        for (size_t i = pc + 1; i < end; ++i) {
+            const bh_instruction &instr = instr_list[i];
+            if (instr.opcode == BH_FREE) {
+                if (util::exist(created, instr.operand[0].base)) {
+                    epilogue.instr_list.push_back(instr);
+                }
+            } else if (instr.opcode != BH_NONE) {
+                bh_instruction tile_instr = instr;
+                for (bh_view &view: tile_instr.operand) {
+                    if (not bh_is_constant(&view)) {
+                        view = row_slice(view, begin, tile_end);
+                    }
+                }
+                epilogue.instr_list.push_back(std::move(tile_instr));
+            }
+        }
+        self->execute(&epilogue);
+    }
+    return frees;
+}
+}
+
+vector<bh_instruction> util_extract_dependencies(vector<bh_instruction> &instr_list,
+                                                 const set<const bh_base *> &bases) {
+    // BH_REPEAT and instructions without operands depend on their position in the list
+    for (const bh_instruction &instr: instr_list) {
+        if (instr.opcode == BH_REPEAT or (instr.operand.empty() and instr.opcode != BH_NONE)) {
+            vector<bh_instruction> ret;
+            ret.swap(instr_list);
+            return ret;
+        }
+    }
+    // The arrays read and written by the extracted instructions, which are found backwards.
+    // NB: we do not know which operands an extension method writes thus we consider all of them written
+    set<const bh_base *> read, written(bases);
+    vector<bool> extract(instr_list.size(), false);
+    for (size_t i = instr_list.size(); i-- > 0;) {
+        const bh_instruction &instr = instr_list[i];
+        for (size_t o = 0; o < instr.operand.size() and not extract[i]; ++o) {
+            const bh_view &view = instr.operand[o];
+            if (not bh_is_constant(&view)) {
+                const bool write = o == 0 and instr.opcode != BH_SYNC;
+                extract[i] = util::exist(written, view.base) or (write and util::exist(read, view.base));
+            }
+        }
+        if (extract[i]) {
+            for (size_t o = 0; o < instr.operand.size(); ++o) {
+                const bh_view &view = instr.operand[o];
+                if (not bh_is_constant(&view)) {
+                    if (o == 0 and instr.opcode != BH_SYNC) {
+                        written.insert(view.base);
+                    } else {
+                        read.insert(view.base);
+                    }
+                }
+            }
+        }
+    }
+    vector<bh_instruction> ret, independent;
+    for (size_t i = 0; i < instr_list.size(); ++i) {
+        if (extract[i]) {
+            ret.push_back(std::move(instr_list[i]));
+        } else {
+            independent.push_back(std::move(instr_list[i]));
+        }
+    }
+    instr_list = std::move(independent);
+    return ret;
+}
+
 // Handle the extension methods within the 'bhir'
 void util_handle_extmethod(component::ComponentImpl *self,
                            bh_ir *bhir,
-                           std::map<bh_opcode, extmethod::ExtmethodFace> &extmethods) {
+                           std::map<bh_opcode, extmethod::ExtmethodFace> &extmethods,
+                           uint64_t gemm_tile_bytes) {
 
     std::vector<bh_instruction> instr_list;
-    for (bh_instruction &instr: bhir->instr_list) {
+    for (size_t pc = 0; pc < bhir->instr_list.size(); ++pc) {
+        bh_instruction &instr = bhir->instr_list[pc];
         auto ext = extmethods.find(instr.opcode);
         if (ext != extmethods.end()) {
+            // A BLAS gemm with an epilogue that is large enough to tile
+            size_t epilogue_end = pc + 1;
+            int64_t tile_rows = 0;
+            if (gemm_tile_bytes > 0 and ext->second.name() == "blas_gemm") {
+                const bh_view &C = instr.operand[0];
+                const int64_t row_bytes = C.shape[1] * bh_type_size(C.base->type);
+                if (row_bytes > 0) {
+                    tile_rows = std::max(int64_t{16}, static_cast<int64_t>(gemm_tile_bytes) / row_bytes);
+                    if (C.shape[0] > tile_rows) {
+                        epilogue_end = gemm_epilogue_end(bhir->instr_list, pc);
+                    }
+                }
+            }
+
+            // Execute the instructions up until now that the extension method (and its epilogue) depends on.
+            // The independent instructions are kept such that they can fuse with the instructions that follow.
+            set<const bh_base *> bases;
+            for (size_t i = pc; i < epilogue_end; ++i) {
+                for (const bh_view &view: bhir->instr_list[i].operand) {
+                    if (not bh_is_constant(&view)) {
+                        bases.insert(view.base);
+                    }
+                }
+            }
             bh_ir b;
-            b.instr_list = instr_list;
-            self->execute(&b); // Execute the instructions up until now
-            instr_list.clear();
+            b.instr_list = util_extract_dependencies(instr_list, bases);
+            if (not b.instr_list.empty()) {
+                self->execute(&b);
+            }
+
+            if (epilogue_end > pc + 1) {
+                for (bh_instruction &free: execute_gemm_tiled(self, ext->second, bhir->instr_list, pc,
+                                                              epilogue_end, tile_rows)) {
+                    instr_list.push_back(std::move(free));
+                }
+                pc = epilogue_end - 1;
+                continue;
+            }
             ext->second.execute(&instr, NULL); // Execute the extension method
         } else {
             instr_list.push_back(instr);
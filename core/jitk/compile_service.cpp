@@ -0,0 +1,121 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include <jitk/compile_service.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+namespace {
+void write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 and errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw runtime_error(string("CompileService: write failed: ") + strerror(errno));
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+void read_all(int fd, char *data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = recv(fd, data, size, 0);
+        if (n < 0 and errno == EINTR) {
+            continue;
+        }
+        if (n == 0) {
+            throw runtime_error("CompileService: connection closed");
+        }
+        if (n < 0) {
+            throw runtime_error(string("CompileService: read failed: ") + strerror(errno));
+        }
+        data += n;
+        size -= n;
+    }
+}
+}
+
+void compile_service_write(int fd, const string &msg) {
+    const uint64_t size = msg.size();
+    write_all(fd, reinterpret_cast<const char *>(&size), sizeof(size));
+    write_all(fd, msg.data(), msg.size());
+}
+
+string compile_service_read(int fd) {
+    uint64_t size;
+    read_all(fd, reinterpret_cast<char *>(&size), sizeof(size));
+    string ret(size, '\0');
+    if (size > 0) {
+        read_all(fd, &ret[0], size);
+    }
+    return ret;
+}
+
+bool CompileService::compile(const string &cmd_template, const string &object_abspath, const string &source) const {
+    sockaddr_un addr;
+    if (not enabled() or socket_path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    // A hung service must not block the kernel builds of this process
+    timeval tv;
+    tv.tv_sec = static_cast<time_t>(timeout);
+    tv.tv_usec = static_cast<suseconds_t>((timeout - tv.tv_sec) * 1e6);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    bool ret = false;
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0) {
+        try {
+            compile_service_write(fd, cmd_template);
+            compile_service_write(fd, object_abspath);
+            compile_service_write(fd, source);
+            ret = compile_service_read(fd).empty();
+        } catch (const runtime_error &) {
+            ret = false;
+        }
+    }
+    close(fd);
+    return ret;
+}
+
+}} // namespace bohrium::jitk
@@ -19,6 +19,7 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <fstream>
+#include <algorithm>
 #include <numeric>
 #include <queue>
 #include <cassert>
@@ -251,6 +252,233 @@ vector<Block> pre_fuser_lossy(const vector<bh_instruction *> &instr_list) {
     return ret;
 }
 
+namespace {
+// A summary of the instructions of a block under construction, which answers fully_fusible(block, instr)
+// without iterating through the instructions of the block. Only distinct views are recorded, thus the
+// check of a new instruction is independent of the number of instructions in the block.
+class FusibleSummary {
+    // The dominating shape of the non-system instructions (if any)
+    bool _has_shape = false;
+    vector<int64_t> _shape;
+    // The distinct views that the non-system instructions write and access of each base array
+    map<const bh_base*, set<bh_view> > _written, _accessed;
+    // The base arrays that scatters write and that the rest of the non-system instructions access
+    set<const bh_base*> _scattered, _accessed_by_nonscatter;
+
+    static bool is_scatter(const bh_instruction &instr) {
+        return instr.opcode == BH_SCATTER or instr.opcode == BH_COND_SCATTER;
+    }
+
+  public:
+    bool fusible(const bh_instruction &instr) const {
+        if (bh_opcode_is_system(instr.opcode)) {
+            return true;
+        }
+        if (_has_shape and instr.shape() != _shape) {
+            return false;
+        }
+        // Gather reads its first input in arbitrary order
+        if (instr.opcode == BH_GATHER and util::exist(_written, instr.operand[1].base)) {
+            return false;
+        }
+        // Scatter writes in arbitrary order
+        if (is_scatter(instr) and util::exist(_accessed_by_nonscatter, instr.operand[0].base)) {
+            return false;
+        }
+        for (const bh_view &view: instr.operand) {
+            if (bh_is_constant(&view)) {
+                continue;
+            }
+            if (util::exist(_scattered, view.base)) {
+                return false;
+            }
+            // The output of the block cannot conflict with the input and output of 'instr'
+            auto it = _written.find(view.base);
+            if (it != _written.end()) {
+                for (const bh_view &writer: it->second) {
+                    if (not fully_data_parallel_compatible(writer, view)) {
+                        return false;
+                    }
+                }
+            }
+        }
+        // The output of 'instr' cannot conflict with the input and output of the block
+        auto it = _accessed.find(instr.operand[0].base);
+        if (it != _accessed.end()) {
+            for (const bh_view &view: it->second) {
+                if (not fully_data_parallel_compatible(instr.operand[0], view)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void add(const bh_instruction &instr) {
+        if (bh_opcode_is_system(instr.opcode)) {
+            return;
+        }
+        if (not _has_shape) {
+            _shape = instr.shape();
+            _has_shape = true;
+        }
+        if (is_scatter(instr)) {
+            _scattered.insert(instr.operand[0].base);
+        }
+        _written[instr.operand[0].base].insert(instr.operand[0]);
+        for (const bh_view &view: instr.operand) {
+            if (not bh_is_constant(&view)) {
+                _accessed[view.base].insert(view);
+                if (not is_scatter(instr)) {
+                    _accessed_by_nonscatter.insert(view.base);
+                }
+            }
+        }
+    }
+};
+
+// The accesses to a view of a base array: the last instruction that wrote the view and the instructions that
+// have read it since. Older accesses are implicit dependencies of the last write.
+struct ViewAccesses {
+    size_t last_write;
+    vector<size_t> reads;
+};
+
+// Returns the instruction-level dependency graph of 'instr_list' as the successors of each instruction and
+// the number of predecessors of each instruction. Two instructions depend on each other when they access
+// overlapping views of a base array and one of them writes.
+void dependency_graph(const vector<InstrPtr> &instr_list, vector<vector<size_t> > &successors,
+                      vector<size_t> &npredecessors) {
+    const size_t none = instr_list.size();
+    successors.assign(instr_list.size(), vector<size_t>());
+    npredecessors.assign(instr_list.size(), 0);
+    // The accesses of each base array by view. Gathers read, scatters write, and system instructions access
+    // arbitrary elements of the base array, which we record as the view 'nullptr' that overlaps all views.
+    map<const bh_base*, map<const bh_view*, ViewAccesses> > accesses;
+    // Maps a view to the first identical view of the same base array
+    map<bh_view, const bh_view*> distinct_views;
+    size_t barrier = none;  // The last instruction without operands (if any)
+    for (size_t i = 0; i < instr_list.size(); ++i) {
+        const bh_instruction &instr = *instr_list[i];
+        set<size_t> deps;
+        if (instr.opcode == BH_NONE) {
+            continue;
+        }
+        if (instr.operand.empty()) {
+            // Instructions without operands such as BH_TALLY stay in place
+            for (size_t j = 0; j < i; ++j) {
+                deps.insert(j);
+            }
+            barrier = i;
+        } else if (barrier != none) {
+            deps.insert(barrier);
+        }
+        for (size_t o = 0; o < instr.operand.size(); ++o) {
+            const bh_view &view = instr.operand[o];
+            if (bh_is_constant(&view)) {
+                continue;
+            }
+            const bool write = o == 0 and instr.opcode != BH_SYNC;
+            const bool arbitrary = bh_opcode_is_system(instr.opcode) or
+                                   (o == 1 and instr.opcode == BH_GATHER) or
+                                   (o == 0 and (instr.opcode == BH_SCATTER or instr.opcode == BH_COND_SCATTER));
+            const bh_view *key = arbitrary ? nullptr : distinct_views.insert(make_pair(view, &view)).first->second;
+            map<const bh_view*, ViewAccesses> &base_accesses = accesses[view.base];
+            for (const auto &prev: base_accesses) {
+                if (prev.first == nullptr or key == nullptr or not bh_view_disjoint(prev.first, &view)) {
+                    if (prev.second.last_write != none) {
+                        deps.insert(prev.second.last_write);
+                    }
+                    if (write) {
+                        deps.insert(prev.second.reads.begin(), prev.second.reads.end());
+                    }
+                }
+            }
+            auto it = base_accesses.insert(make_pair(key, ViewAccesses{none, {}})).first;
+            if (write) {
+                it->second.last_write = i;
+                it->second.reads.clear();
+            } else {
+                it->second.reads.push_back(i);
+            }
+        }
+        deps.erase(i);
+        for (size_t j: deps) {
+            successors[j].push_back(i);
+        }
+        npredecessors[i] = deps.size();
+    }
+}
+}
+
+vector<Block> pre_fuser_reorder(const vector<bh_instruction *> &instr_list) {
+    const vector<InstrPtr> instr_list_simply = simplify_instr_list(instr_list);
+    vector<vector<size_t> > successors;
+    vector<size_t> npredecessors;
+    dependency_graph(instr_list_simply, successors, npredecessors);
+
+    // The instructions that have all their dependencies scheduled ordered by their original position
+    set<size_t> ready;
+    for (size_t i = 0; i < instr_list_simply.size(); ++i) {
+        if (npredecessors[i] == 0) {
+            ready.insert(i);
+        }
+    }
+
+    // List scheduling: we extend the current block with the first ready instruction that is fully fusible
+    // with it and start a new block when none is. Thus, we preserve the original order as much as possible.
+    // An instruction that isn't fusible with a block never becomes fusible by adding more instructions to the
+    // block, thus 'untested' holds the ready instructions not yet tested against the current block and each
+    // ready instruction is tested at most once per block.
+    vector<vector<InstrPtr> > block_lists;
+    FusibleSummary summary; // The summary of the last block in 'block_lists'
+    set<size_t> untested;
+    while (not ready.empty()) {
+        auto pick = ready.end();
+        if (not block_lists.empty()) {
+            while (not untested.empty()) {
+                const size_t idx = *untested.begin();
+                untested.erase(untested.begin());
+                if (summary.fusible(*instr_list_simply[idx])) {
+                    pick = ready.find(idx);
+                    break;
+                }
+            }
+        }
+        if (pick == ready.end()) {
+            // We should not make blocks that start with a sysop since we only have LoopB::insert_system_after()
+            pick = ready.begin();
+            for (auto it = ready.begin(); it != ready.end(); ++it) {
+                if (not bh_opcode_is_system(instr_list_simply[*it]->opcode)) {
+                    pick = it;
+                    break;
+                }
+            }
+            block_lists.push_back({});
+            summary = FusibleSummary();
+            untested = ready;
+            untested.erase(*pick);
+        }
+        const size_t idx = *pick;
+        ready.erase(pick);
+        block_lists.back().push_back(instr_list_simply[idx]);
+        summary.add(*instr_list_simply[idx]);
+        for (size_t succ: successors[idx]) {
+            if (--npredecessors[succ] == 0) {
+                ready.insert(succ);
+                untested.insert(succ);
+            }
+        }
+    }
+
+    // Convert the block list to real Blocks
+    vector<Block> ret;
+    for (const vector<InstrPtr> &block: block_lists) {
+        ret.push_back(create_nested_block(block));
+    }
+    return ret;
+}
+
 vector<Block> fuser_singleton(const vector<bh_instruction *> &instr_list) {
 
     const vector<InstrPtr> instr_list_simply = simplify_instr_list(instr_list);
@@ -390,5 +618,29 @@ void fuser_greedy(vector<Block> &block_list, bool avoid_rank0_sweep) {
     block_list = ret;
 }
 
+void fuser_greedy_reachability(vector<Block> &block_list, bool avoid_rank0_sweep, uint64_t window) {
+    vector<Block> ret;
+    if (window == 0 or block_list.size() <= window) {
+        ret = block_list;
+        graph::greedy_reachability(ret, avoid_rank0_sweep);
+    } else {
+        // The block list is in topological order thus each window can be fused independently
+        for (size_t begin = 0; begin < block_list.size(); begin += window) {
+            const size_t end = std::min<size_t>(begin + window, block_list.size());
+            vector<Block> part(block_list.begin() + begin, block_list.begin() + end);
+            graph::greedy_reachability(part, avoid_rank0_sweep);
+            ret.insert(ret.end(), part.begin(), part.end());
+        }
+    }
+
+    // Let's fuse at the next rank level
+    for (Block &b: ret) {
+        if (not b.isInstr()) {
+            fuser_greedy_reachability(b.getLoop()._block_list, avoid_rank0_sweep, window);
+        }
+    }
+    block_list = ret;
+}
+
 } // jitk
 } // bohrium
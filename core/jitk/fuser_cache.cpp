@@ -69,16 +69,6 @@ void hash_instr(const bh_instruction &instr, seqset<bh_view> &views, std::string
     ss << SEP_INSTR;
 }
 
-// Hash of an instruction list
-size_t hash_instr_list(const vector<bh_instruction *> &instr_list) {
-    stringstream ss;
-    seqset<bh_view> views;
-    for (const bh_instruction *instr: instr_list) {
-        hash_instr(*instr, views, ss);
-    }
-    return hasher(ss.str());
-}
-
 void updateWithOrigin(bh_view &view, const bh_view &origin) {
     view.base = origin.base;
 }
@@ -114,6 +104,15 @@ void updateWithOrigin(Block &block, const map<int64_t, const bh_instruction *> &
 
 } // Anon namespace
 
+size_t hash_instr_list(const vector<bh_instruction *> &instr_list) {
+    stringstream ss;
+    seqset<bh_view> views;
+    for (const bh_instruction *instr: instr_list) {
+        hash_instr(*instr, views, ss);
+    }
+    return hasher(ss.str());
+}
+
 pair<vector<Block>, bool> FuseCache::get(const vector<bh_instruction *> &instr_list) {
     const size_t lookup_hash = hash_instr_list(instr_list);
     ++stat.fuser_cache_lookups;
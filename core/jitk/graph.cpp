@@ -24,13 +24,16 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <boost/graph/graphviz.hpp>
 #include <boost/graph/topological_sort.hpp>
 #include <boost/foreach.hpp>
+#include <boost/dynamic_bitset.hpp>
 #include <fstream>
+#include <algorithm>
 #include <numeric>
 #include <queue>
 #include <cassert>
 
 #include <jitk/graph.hpp>
 #include <jitk/block.hpp>
+#include <bh_util.hpp>
 
 using namespace std;
 
@@ -347,6 +350,197 @@ void greedy(DAG &dag, bool avoid_rank0_sweep) {
     assert(validate(dag));
 }
 
+void greedy_reachability(vector<Block> &block_list, bool avoid_rank0_sweep) {
+    const size_t n = block_list.size();
+    if (n < 2) {
+        return;
+    }
+
+    // The dependencies between the blocks. Like bh_instr_dependency(), we consider the accesses to a base array
+    // overlapping thus a block depends on the last block that wrote each base array it accesses and a writing
+    // block depends on the blocks that read the base array since then. The rest of the dependencies are implied.
+    vector<set<size_t> > succ(n), pred(n);
+    {
+        map<const bh_base*, size_t> last_writer;
+        map<const bh_base*, vector<size_t> > readers;
+        for (size_t v = 0; v < n; ++v) {
+            set<const bh_base*> writes, reads;
+            for (const InstrPtr &instr: block_list[v].getAllInstr()) {
+                for (size_t i = 0; i < instr->operand.size(); ++i) {
+                    if (not bh_is_constant(&instr->operand[i])) {
+                        (i == 0 ? writes : reads).insert(instr->operand[i].base);
+                    }
+                }
+            }
+            set<size_t> deps;
+            for (const set<const bh_base*> *bases: {&writes, &reads}) {
+                for (const bh_base *base: *bases) {
+                    auto it = last_writer.find(base);
+                    if (it != last_writer.end()) {
+                        deps.insert(it->second);
+                    }
+                }
+            }
+            for (const bh_base *base: writes) {
+                vector<size_t> &rs = readers[base];
+                deps.insert(rs.begin(), rs.end());
+                rs.clear();
+                last_writer[base] = v;
+            }
+            for (const bh_base *base: reads) {
+                if (not util::exist(writes, base)) {
+                    readers[base].push_back(v);
+                }
+            }
+            deps.erase(v);
+            for (size_t u: deps) {
+                succ[u].insert(v);
+                pred[v].insert(u);
+            }
+        }
+    }
+
+    // The descendants and ancestors of each block. NB: the block list is in topological order
+    vector<boost::dynamic_bitset<> > desc(n, boost::dynamic_bitset<>(n)), anc(n, boost::dynamic_bitset<>(n));
+    for (size_t v = n; v-- > 0; ) {
+        for (size_t s: succ[v]) {
+            desc[v].set(s);
+            desc[v] |= desc[s];
+        }
+    }
+    for (size_t v = 0; v < n; ++v) {
+        for (size_t p: pred[v]) {
+            anc[v].set(p);
+            anc[v] |= anc[p];
+        }
+    }
+
+    // The fusion candidates ordered by weight. A candidate is stale when one of its blocks has changed.
+    struct Candidate {
+        uint64_t weight;
+        size_t a, b;
+        uint64_t a_version, b_version;
+        bool operator<(const Candidate &other) const {
+            if (weight != other.weight) return weight < other.weight;
+            if (a != other.a) return a > other.a;
+            return b > other.b;
+        }
+    };
+    vector<uint64_t> version(n, 0);
+    vector<bool> alive(n, true);
+    // The new and freed base arrays of each block, which gives the weight of a merge as in weight()
+    vector<set<bh_base*> > news(n), frees(n);
+    for (size_t v = 0; v < n; ++v) {
+        if (not block_list[v].isInstr()) {
+            news[v] = block_list[v].getLoop().getAllNews();
+            frees[v] = block_list[v].getLoop().getAllFrees();
+        }
+    }
+    priority_queue<Candidate> candidates;
+    auto push_candidate = [&](size_t a, size_t b) {
+        uint64_t weight = 0;
+        if (not block_list[a].isInstr() and not block_list[b].isInstr()) {
+            const bool a_smallest = news[a].size() < frees[b].size();
+            for (bh_base *base: a_smallest ? news[a] : frees[b]) {
+                if (util::exist(a_smallest ? frees[b] : news[a], base)) {
+                    weight += bh_base_size(base);
+                }
+            }
+        }
+        candidates.push({weight, a, b, version[a], version[b]});
+    };
+    for (size_t a = 0; a < n; ++a) {
+        for (size_t b: succ[a]) {
+            push_candidate(a, b);
+        }
+    }
+
+    while (not candidates.empty()) {
+        const Candidate c = candidates.top();
+        candidates.pop();
+        const size_t a = c.a, b = c.b;
+        if (not alive[a] or not alive[b] or version[a] != c.a_version or version[b] != c.b_version) {
+            continue;
+        }
+        // The merge is legal when no path goes from 'a' to 'b' through another block
+        if (desc[a].intersects(anc[b]) or not mergeable(block_list[a], block_list[b], avoid_rank0_sweep)) {
+            continue;
+        }
+        block_list[a] = reshape_and_merge(block_list[a].getLoop(), block_list[b].getLoop());
+        assert(block_list[a].validation());
+        alive[b] = false;
+        ++version[a];
+        news[a].insert(news[b].begin(), news[b].end());
+        frees[a].insert(frees[b].begin(), frees[b].end());
+        news[b].clear();
+        frees[b].clear();
+
+        // Move the dependencies of 'b' to 'a'
+        succ[a].erase(b);
+        for (size_t s: succ[b]) {
+            pred[s].erase(b);
+            pred[s].insert(a);
+            succ[a].insert(s);
+        }
+        for (size_t p: pred[b]) {
+            if (p != a) {
+                succ[p].erase(b);
+                succ[p].insert(a);
+                pred[a].insert(p);
+            }
+        }
+        succ[b].clear();
+        pred[b].clear();
+
+        // Update the reachability of the ancestors and descendants of the merged block
+        desc[a].reset(b);
+        anc[a] |= anc[b];
+        anc[a].reset(a);
+        for (size_t x = anc[a].find_first(); x != boost::dynamic_bitset<>::npos; x = anc[a].find_next(x)) {
+            desc[x] |= desc[a];
+            desc[x].set(a);
+            desc[x].reset(b);
+        }
+        for (size_t y = desc[a].find_first(); y != boost::dynamic_bitset<>::npos; y = desc[a].find_next(y)) {
+            anc[y] |= anc[a];
+            anc[y].set(a);
+            anc[y].reset(b);
+        }
+        desc[b].reset();
+        anc[b].reset();
+
+        for (size_t s: succ[a]) {
+            push_candidate(a, s);
+        }
+        for (size_t p: pred[a]) {
+            push_candidate(p, a);
+        }
+    }
+
+    // Write the remaining blocks in topological order preferring the original order
+    vector<size_t> npred(n);
+    priority_queue<size_t, vector<size_t>, greater<size_t> > roots;
+    for (size_t v = 0; v < n; ++v) {
+        npred[v] = pred[v].size();
+        if (alive[v] and npred[v] == 0) {
+            roots.push(v);
+        }
+    }
+    vector<Block> ret;
+    while (not roots.empty()) {
+        const size_t v = roots.top();
+        roots.pop();
+        ret.push_back(std::move(block_list[v]));
+        for (size_t s: succ[v]) {
+            if (--npred[s] == 0) {
+                roots.push(s);
+            }
+        }
+    }
+    assert(ret.size() == (size_t) count(alive.begin(), alive.end(), true));
+    block_list = std::move(ret);
+}
+
 } // graph
 } // jitk
 } // bohrium
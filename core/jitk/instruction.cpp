@@ -51,8 +51,24 @@ void write_opcodes_with_special_opencl_complex(const bh_instruction &instr, cons
     }
 }
 
-// Write the 'instr' using the string in 'ops' as ops
-void write_operation(const bh_instruction &instr, const vector<string> &ops, stringstream &out, bool opencl) {
+// Write the 'instr' using the string in 'ops' as ops. When 'nontemporal', the output element 'ops[0]' is written
+// by the non-temporal store macro `BH_STREAM_STORE<nbytes>(ptr, value)`, which the kernel must define.
+void write_operation(const bh_instruction &instr, const vector<string> &ops, stringstream &out, bool opencl,
+                     bool nontemporal = false) {
+    if (nontemporal) {
+        // We compute the value into a local variable, which we then store
+        vector<string> local_ops(ops);
+        local_ops[0] = "nt_value";
+        stringstream ss;
+        write_operation(instr, local_ops, ss, opencl);
+        string operation = ss.str();
+        if (not operation.empty() and operation.back() == '\n') {
+            operation.pop_back();
+        }
+        out << "{__typeof__(" << ops[0] << ") nt_value; " << operation << " BH_STREAM_STORE"
+            << bh_type_size(instr.operand[0].base->type) << "(&" << ops[0] << ", nt_value);}\n";
+        return;
+    }
     switch (instr.opcode) {
         // Opcodes that are Complex/OpenCL agnostic
         case BH_BITWISE_AND:
@@ -558,9 +574,10 @@ void dtype_min(bh_type dtype, stringstream &out) {
 
 } // Anon namespace
 
-void write_instr(const Scope &scope, const bh_instruction &instr, stringstream &out, bool opencl) {
+void write_instr(const Scope &scope, const bh_instruction &instr, stringstream &out, bool opencl, bool nontemporal) {
     if (bh_opcode_is_system(instr.opcode))
         return;
+    nontemporal = nontemporal and scope.isArray(instr.operand[0]);
     if (instr.opcode == BH_RANGE) {
         vector<string> ops;
         // Write output operand
@@ -582,7 +599,7 @@ void write_instr(const Scope &scope, const bh_instruction &instr, stringstream &
             ss << ")";
             ops.push_back(ss.str());
         }
-        write_operation(instr, ops, out, opencl);
+        write_operation(instr, ops, out, opencl, nontemporal);
         return;
     }
     if (instr.opcode == BH_RANDOM) {
@@ -609,7 +626,7 @@ void write_instr(const Scope &scope, const bh_instruction &instr, stringstream &
             ss << ")";
             ops.push_back(ss.str());
         }
-        write_operation(instr, ops, out, opencl);
+        write_operation(instr, ops, out, opencl, nontemporal);
         return;
     }
     if (bh_opcode_is_accumulate(instr.opcode)) {
@@ -639,7 +656,7 @@ void write_instr(const Scope &scope, const bh_instruction &instr, stringstream &
             }
             ops.push_back(ss.str());
         }
-        write_operation(instr, ops, out, opencl);
+        write_operation(instr, ops, out, opencl, nontemporal);
         return;
     }
     if (instr.opcode == BH_GATHER) {
@@ -665,7 +682,7 @@ void write_instr(const Scope &scope, const bh_instruction &instr, stringstream &
             ss << "]";
             ops.push_back(ss.str());
         }
-        write_operation(instr, ops, out, opencl);
+        write_operation(instr, ops, out, opencl, nontemporal);
         return;
     }
     if (instr.opcode == BH_SCATTER or instr.opcode == BH_COND_SCATTER) {
@@ -698,7 +715,7 @@ void write_instr(const Scope &scope, const bh_instruction &instr, stringstream &
             }
             ops.push_back(ss.str());
         }
-        write_operation(instr, ops, out, opencl);
+        write_operation(instr, ops, out, opencl, nontemporal);
         return;
     }
 
@@ -728,7 +745,38 @@ void write_instr(const Scope &scope, const bh_instruction &instr, stringstream &
         }
         ops.push_back(ss.str());
     }
-    write_operation(instr, ops, out, opencl);
+    write_operation(instr, ops, out, opencl, nontemporal);
+}
+
+void write_prefetch(const Scope &scope, const bh_instruction &instr, stringstream &out) {
+    if (scope.prefetch_distance <= 0) {
+        return;
+    }
+    if (not (instr.opcode == BH_GATHER or instr.opcode == BH_SCATTER or instr.opcode == BH_COND_SCATTER)) {
+        return;
+    }
+    // The index array of both GATHER and SCATTER is the third operand. We can only look ahead when the index
+    // array is a regular array that varies along the innermost axis.
+    const bh_view &index = instr.operand[2];
+    if (index.ndim == 0 or not scope.isArray(index) or index.stride[index.ndim - 1] == 0) {
+        return;
+    }
+    // The indirectly accessed array: the input of GATHER and the output of SCATTER
+    const bool is_write = instr.opcode != BH_GATHER;
+    const bh_view &target = is_write ? instr.operand[0] : instr.operand[1];
+    if (not scope.isArray(target)) {
+        return;
+    }
+    const int axis = static_cast<int>(index.ndim - 1);
+
+    // Format: if (i + dist < size) __builtin_prefetch(&target[target.start + index[<loop-indexes> + dist]], rw);
+    out << "if (i" << axis << " + " << scope.prefetch_distance << " < " << index.shape[axis] << ") ";
+    out << "__builtin_prefetch(&";
+    scope.getName(target, out);
+    out << "[" << target.start << " + ";
+    scope.getName(index, out);
+    write_array_subscription(scope, index, out, true, BH_MAXDIM, make_pair(axis, scope.prefetch_distance));
+    out << "], " << (is_write ? 1 : 0) << ");\n";
 }
 
 bool has_reduce_identity(bh_opcode opcode) {
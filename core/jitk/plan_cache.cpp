@@ -0,0 +1,67 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+#include <sstream>
+#include <boost/functional/hash.hpp>
+
+#include <jitk/plan_cache.hpp>
+#include <jitk/fuser_cache.hpp>
+#include <bh_seqset.hpp>
+
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+size_t hash_plan(const vector<bh_instruction *> &instr_list, bool const_as_var) {
+    stringstream ss;
+    seqset<const bh_base*> bases;
+    for (const bh_instruction *instr: instr_list) {
+        ss << instr->constructor << ":";
+        for (const bh_view &view: instr->operand) {
+            if (bh_is_constant(&view)) {
+                ss << "c" << static_cast<int>(instr->constant.type);
+                // Constants that aren't kernel arguments are written into the source
+                if (not bh_opcode_is_sweep(instr->opcode) and
+                    (not const_as_var or not bh_opcode_is_elementwise(instr->opcode) or instr->opcode == BH_RANDOM)) {
+                    ss << "=";
+                    if (instr->opcode == BH_RANDOM) {
+                        ss << instr->constant.value.r123.start << "," << instr->constant.value.r123.key;
+                    } else {
+                        instr->constant.pprint(ss, false);
+                    }
+                }
+            } else {
+                ss << "a" << bases.insert(view.base).first << "t" << static_cast<int>(view.base->type)
+                   << "n" << view.base->nelem;
+            }
+            ss << ",";
+        }
+        ss << ";";
+    }
+    size_t ret = hash_instr_list(instr_list);
+    boost::hash_combine(ret, ss.str());
+    return ret;
+}
+
+} // jitk
+} // bohrium
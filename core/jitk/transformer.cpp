@@ -18,6 +18,9 @@ GNU Lesser General Public License along with Bohrium.
 If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <cstdlib>
+
 #include <jitk/transformer.hpp>
 
 using namespace std;
@@ -59,6 +62,54 @@ vector<Block> swap_blocks(const LoopB &parent, const LoopB *child) {
     return ret;
 }
 
+// Help function that returns the order of the axes in 'instr_list' that minimizes the strides of the inner axes.
+// The axes are sorted by the sum of their strides (in bytes), largest first.
+// Returns the empty vector if 'instr_list' isn't a list of non-sweep instructions with identical shapes.
+vector<int64_t> find_locality_axis_order(const vector<InstrPtr> &instr_list) {
+    vector<int64_t> shape;
+    for (const InstrPtr &instr: instr_list) {
+        if (bh_opcode_is_system(instr->opcode)) {
+            continue;
+        }
+        if (bh_opcode_is_sweep(instr->opcode) or instr->operand.empty()) {
+            return {};
+        }
+        for (const bh_view &view: instr->operand) {
+            if (bh_is_constant(&view)) {
+                continue;
+            }
+            const vector<int64_t> view_shape(view.shape, view.shape + view.ndim);
+            if (shape.empty()) {
+                shape = view_shape;
+            } else if (shape != view_shape) {
+                return {};
+            }
+        }
+    }
+    if (shape.size() < 2) {
+        return {};
+    }
+    vector<uint64_t> cost(shape.size(), 0);
+    for (const InstrPtr &instr: instr_list) {
+        if (bh_opcode_is_system(instr->opcode)) {
+            continue;
+        }
+        for (const bh_view &view: instr->operand) {
+            if (not bh_is_constant(&view)) {
+                for (int64_t i = 0; i < view.ndim; ++i) {
+                    cost[i] += static_cast<uint64_t>(std::abs(view.stride[i])) * bh_type_size(view.base->type);
+                }
+            }
+        }
+    }
+    vector<int64_t> ret(shape.size());
+    for (size_t i = 0; i < ret.size(); ++i) {
+        ret[i] = i;
+    }
+    std::stable_sort(ret.begin(), ret.end(), [&cost](int64_t a, int64_t b) { return cost[a] > cost[b]; });
+    return ret;
+}
+
 // Help function that find a loop block within 'parent' that it make sense to swappable
 const LoopB *find_swappable_sub_block(const LoopB &parent) {
     // For each sweep, we look for a sub-block that contains that sweep instructions.
@@ -158,6 +209,42 @@ void push_reductions_inwards(vector<Block> &block_list) {
     block_list = ret;
 }
 
+void interchange_for_locality(vector<Block> &block_list) {
+    for (Block &block: block_list) {
+        if (block.isInstr()) {
+            continue;
+        }
+        vector<InstrPtr> instr_list = block.getLoop().getAllInstr();
+        // NB: a nested block cannot start with a system instruction
+        if (instr_list.empty() or bh_opcode_is_system(instr_list[0]->opcode)) {
+            continue;
+        }
+        const vector<int64_t> order = find_locality_axis_order(instr_list);
+        if (order.empty()) {
+            continue;
+        }
+        // Let's apply the new order one swap at a time. NB: all instructions have identical shapes and no sweeps
+        // thus every loop order is legal.
+        vector<int64_t> current(order.size());
+        for (size_t i = 0; i < current.size(); ++i) {
+            current[i] = i;
+        }
+        bool changed = false;
+        for (size_t i = 0; i < order.size(); ++i) {
+            const auto it = std::find(current.begin(), current.end(), order[i]);
+            const int64_t j = it - current.begin();
+            if (j != static_cast<int64_t>(i)) {
+                instr_list = swap_axis(instr_list, i, j);
+                std::swap(current[i], current[j]);
+                changed = true;
+            }
+        }
+        if (changed) {
+            block = create_nested_block(instr_list, block.rank());
+        }
+    }
+}
+
 void split_for_threading(vector<Block> &block_list, uint64_t min_threading, uint64_t cur_threading) {
     vector<Block> ret;
 
@@ -17,8 +17,24 @@ GNU Lesser General Public License along with Bohrium.
 
 If not, see <http://www.gnu.org/licenses/>.
 */
+
+/* The FFTW extension methods:
+ *   fftw      out = fftn(in)   where `in` and `out` are complex128 or complex64 and operand 2 is the int32 sign
+ *   fftw_r2c  out = rfftn(in)  where `in` is float64 or float32 and `out` is the matching complex type, which has
+ *                              `in.shape[-1] / 2 + 1` elements in the last dimension
+ *   fftw_c2r  out = irfftn(in) the inverse of `fftw_r2c`, which leaves `in` untouched
+ * None of the transforms are normalized. The plans are cached between calls and the wisdom of the planner is saved
+ * in the `cache_dir` of the [fftw] config section. The float32 and complex64 transforms use the single-precision
+ * FFTW when Bohrium was built with it (BH_FFTW_FLOAT) and are computed in double precision otherwise.
+ */
+
 #include <stdexcept>
 #include <cassert>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
 #include <fftw3.h>
 #if defined(_OPENMP)
 #include <omp.h>
@@ -35,52 +51,443 @@ using namespace extmethod;
 using namespace std;
 
 namespace {
-class Impl : public ExtmethodImpl {
+
+// The kind of the transform
+enum class Kind { C2C, R2C, C2R };
+
+// The double and single precision FFTW interfaces
+template<typename Real>
+struct Fftw;
+
+template<>
+struct Fftw<double> {
+    typedef fftw_complex Complex;
+    typedef fftw_plan Plan;
+    static Plan plan(Kind kind, int rank, const fftw_iodim64 *dims, void *in, void *out, int sign, unsigned flags) {
+        switch (kind) {
+            case Kind::C2C:
+                return fftw_plan_guru64_dft(rank, dims, 0, nullptr, (Complex *) in, (Complex *) out, sign, flags);
+            case Kind::R2C:
+                return fftw_plan_guru64_dft_r2c(rank, dims, 0, nullptr, (double *) in, (Complex *) out, flags);
+            default:
+                return fftw_plan_guru64_dft_c2r(rank, dims, 0, nullptr, (Complex *) in, (double *) out, flags);
+        }
+    }
+    static void execute(Kind kind, Plan plan, void *in, void *out) {
+        switch (kind) {
+            case Kind::C2C:
+                fftw_execute_dft(plan, (Complex *) in, (Complex *) out);
+                break;
+            case Kind::R2C:
+                fftw_execute_dft_r2c(plan, (double *) in, (Complex *) out);
+                break;
+            default:
+                fftw_execute_dft_c2r(plan, (Complex *) in, (double *) out);
+        }
+    }
+    static void destroy_plan(Plan plan) { fftw_destroy_plan(plan); }
+    static void *malloc(size_t nbytes) { return fftw_malloc(nbytes); }
+    static void free(void *ptr) { fftw_free(ptr); }
+    static bool aligned(void *ptr) { return fftw_alignment_of((double *) ptr) == 0; }
+    static void init_threads() { fftw_init_threads(); }
+    static void plan_with_nthreads(int nthreads) { fftw_plan_with_nthreads(nthreads); }
+    static void import_wisdom(const string &filename) { fftw_import_wisdom_from_filename(filename.c_str()); }
+    static void export_wisdom(const string &filename) { fftw_export_wisdom_to_filename(filename.c_str()); }
+};
+
+#ifdef BH_FFTW_FLOAT
+template<>
+struct Fftw<float> {
+    typedef fftwf_complex Complex;
+    typedef fftwf_plan Plan;
+    static Plan plan(Kind kind, int rank, const fftw_iodim64 *dims, void *in, void *out, int sign, unsigned flags) {
+        switch (kind) {
+            case Kind::C2C:
+                return fftwf_plan_guru64_dft(rank, dims, 0, nullptr, (Complex *) in, (Complex *) out, sign, flags);
+            case Kind::R2C:
+                return fftwf_plan_guru64_dft_r2c(rank, dims, 0, nullptr, (float *) in, (Complex *) out, flags);
+            default:
+                return fftwf_plan_guru64_dft_c2r(rank, dims, 0, nullptr, (Complex *) in, (float *) out, flags);
+        }
+    }
+    static void execute(Kind kind, Plan plan, void *in, void *out) {
+        switch (kind) {
+            case Kind::C2C:
+                fftwf_execute_dft(plan, (Complex *) in, (Complex *) out);
+                break;
+            case Kind::R2C:
+                fftwf_execute_dft_r2c(plan, (float *) in, (Complex *) out);
+                break;
+            default:
+                fftwf_execute_dft_c2r(plan, (Complex *) in, (float *) out);
+        }
+    }
+    static void destroy_plan(Plan plan) { fftwf_destroy_plan(plan); }
+    static void *malloc(size_t nbytes) { return fftwf_malloc(nbytes); }
+    static void free(void *ptr) { fftwf_free(ptr); }
+    static bool aligned(void *ptr) { return fftwf_alignment_of((float *) ptr) == 0; }
+    static void init_threads() { fftwf_init_threads(); }
+    static void plan_with_nthreads(int nthreads) { fftwf_plan_with_nthreads(nthreads); }
+    static void import_wisdom(const string &filename) { fftwf_import_wisdom_from_filename(filename.c_str()); }
+    static void export_wisdom(const string &filename) { fftwf_export_wisdom_to_filename(filename.c_str()); }
+};
+#endif
+
+// A plan is valid for all arrays with the same layout and alignment thus we key the plans by the layout
+struct PlanKey {
+    Kind kind;
+    int sign;
+    bool in_place;
+    bool aligned;
+    int nthreads;
+    vector<int64_t> shape; // The shape of the real (or complex for C2C) array
+    vector<int64_t> in_stride;
+    vector<int64_t> out_stride;
+
+    bool operator<(const PlanKey &other) const {
+        return tie(kind, sign, in_place, aligned, nthreads, shape, in_stride, out_stride) <
+               tie(other.kind, other.sign, other.in_place, other.aligned, other.nthreads, other.shape,
+                   other.in_stride, other.out_stride);
+    }
+};
+
+// Returns the lowest and the highest element offset of the 'shape' and 'stride' layout
+pair<int64_t, int64_t> offset_range(const vector<int64_t> &shape, const vector<int64_t> &stride) {
+    int64_t low = 0, high = 0;
+    for (size_t i = 0; i < shape.size(); ++i) {
+        if (stride[i] < 0) {
+            low += (shape[i] - 1) * stride[i];
+        } else {
+            high += (shape[i] - 1) * stride[i];
+        }
+    }
+    return make_pair(low, high);
+}
+
+// The plan cache of one precision
+template<typename Real>
+class PlanCache {
+    typedef Fftw<Real> F;
+    typedef typename F::Plan Plan;
+    // The planner flags such as FFTW_MEASURE
+    const unsigned _flags;
+    map<PlanKey, Plan> _plans;
+    // Scratch buffer for the input of C2R transforms, which FFTW overwrites
+    void *_scratch = nullptr;
+    size_t _scratch_nbytes = 0;
 public:
-    void execute(bh_instruction *instr, void* arg) {
-        bh_view *out  = &instr->operand[0];
-        bh_view *in   = &instr->operand[1];
-        bh_int32 *args = (bh_int32 *) instr->operand[2].base->data;
-        assert(args != NULL);
-        assert(instr->operand[2].base->nelem == 1);
-        assert(in->ndim == out->ndim);
-        assert(out->base->type == BH_COMPLEX128);
-        assert(in->base->type == BH_COMPLEX128);
+    // True when the cache has planned with more than FFTW_ESTIMATE, which makes the wisdom worth saving
+    bool new_wisdom = false;
 
-        int sign = args[0];
+    explicit PlanCache(unsigned flags) : _flags(flags) {}
+    ~PlanCache() {
+        for (auto &plan: _plans) {
+            F::destroy_plan(plan.second);
+        }
+        F::free(_scratch);
+    }
 
-        //Make sure that the arrays memory are allocated.
-        bh_data_malloc(out->base);
-        bh_data_malloc(in->base);
+    // Returns a buffer of at least 'nbytes' bytes, which is reused between calls
+    void *scratch(size_t nbytes) {
+        if (nbytes > _scratch_nbytes) {
+            F::free(_scratch);
+            _scratch = F::malloc(nbytes);
+            if (_scratch == nullptr) {
+                throw runtime_error("fftw: cannot allocate the scratch buffer");
+            }
+            _scratch_nbytes = nbytes;
+        }
+        return _scratch;
+    }
 
-        fftw_complex *i = (fftw_complex*) in->base->data;
-        fftw_complex *o = (fftw_complex*) out->base->data;
+    // Returns the plan of 'key'. We plan on temporary arrays since FFTW_MEASURE and FFTW_PATIENT overwrite them.
+    Plan get(const PlanKey &key) {
+        auto it = _plans.find(key);
+        if (it != _plans.end()) {
+            return it->second;
+        }
+        const size_t real_size = sizeof(Real);
+        const size_t in_size = key.kind == Kind::R2C ? real_size : 2 * real_size;
+        const size_t out_size = key.kind == Kind::C2R ? real_size : 2 * real_size;
+        vector<int64_t> in_shape(key.shape), out_shape(key.shape);
+        if (key.kind == Kind::R2C) {
+            out_shape.back() = out_shape.back() / 2 + 1;
+        } else if (key.kind == Kind::C2R) {
+            in_shape.back() = in_shape.back() / 2 + 1;
+        }
+        const auto in_range = offset_range(in_shape, key.in_stride);
+        const auto out_range = offset_range(out_shape, key.out_stride);
+        const size_t in_begin = -in_range.first * in_size, in_end = in_begin + (in_range.second + 1) * in_size;
+        const size_t out_begin = -out_range.first * out_size, out_end = out_begin + (out_range.second + 1) * out_size;
 
-        //Convert shape to int
-        int shape[BH_MAXDIM];
-        for(int i=0; i<in->ndim; ++i)
-        {
-            shape[i] = in->shape[i];
-            assert(shape[i] == out->shape[i]);
+        vector<fftw_iodim64> dims(key.shape.size());
+        for (size_t i = 0; i < dims.size(); ++i) {
+            dims[i].n = key.shape[i];
+            dims[i].is = key.in_stride[i];
+            dims[i].os = key.out_stride[i];
+        }
+        const unsigned flags = key.aligned ? _flags : _flags | FFTW_UNALIGNED;
+        F::plan_with_nthreads(key.nthreads);
+        Plan plan;
+        if (key.in_place) {
+            const size_t begin = std::max(in_begin, out_begin);
+            char *buf = (char *) F::malloc(begin + std::max(in_end - in_begin, out_end - out_begin));
+            plan = F::plan(key.kind, (int) dims.size(), &dims[0], buf + begin, buf + begin, key.sign, flags);
+            F::free(buf);
+        } else {
+            char *in = (char *) F::malloc(in_end);
+            char *out = (char *) F::malloc(out_end);
+            plan = F::plan(key.kind, (int) dims.size(), &dims[0], in + in_begin, out + out_begin, key.sign, flags);
+            F::free(in);
+            F::free(out);
+        }
+        if (plan == nullptr) {
+            throw runtime_error("fftw: plan fail!");
         }
+        new_wisdom = new_wisdom or (_flags & FFTW_ESTIMATE) == 0;
+        _plans.insert(make_pair(key, plan));
+        return plan;
+    }
+};
 
-        fftw_init_threads();
-        fftw_plan_with_nthreads(omp_get_max_threads());
+// The state shared by all FFTW extension methods, which lives as long as one of them exists
+class Planner {
+    const string _cache_dir;
+    const bool _use_wisdom;
+public:
+#ifdef BH_FFTW_FLOAT
+    PlanCache<float> plans32;
+#endif
+    PlanCache<double> plans64;
 
-        fftw_plan p = fftw_plan_dft(in->ndim, shape, i, o, sign, FFTW_ESTIMATE);
-        if(p == NULL)
-            throw runtime_error("fftw plan fail!");
+    Planner(const string &cache_dir, const string &planner) : _cache_dir(cache_dir),
+                                                              _use_wisdom(planner != "estimate"),
+#ifdef BH_FFTW_FLOAT
+                                                              plans32(planner_flags(planner)),
+#endif
+                                                              plans64(planner_flags(planner)) {
+        Fftw<double>::init_threads();
+#ifdef BH_FFTW_FLOAT
+        Fftw<float>::init_threads();
+#endif
+        if (_use_wisdom and not _cache_dir.empty()) {
+            Fftw<double>::import_wisdom(_cache_dir + "/fftw_wisdom");
+#ifdef BH_FFTW_FLOAT
+            Fftw<float>::import_wisdom(_cache_dir + "/fftwf_wisdom");
+#endif
+        }
+    }
+    ~Planner() {
+        if (_use_wisdom and not _cache_dir.empty()) {
+            if (plans64.new_wisdom) {
+                Fftw<double>::export_wisdom(_cache_dir + "/fftw_wisdom");
+            }
+#ifdef BH_FFTW_FLOAT
+            if (plans32.new_wisdom) {
+                Fftw<float>::export_wisdom(_cache_dir + "/fftwf_wisdom");
+            }
+#endif
+        }
+    }
 
-        fftw_execute(p);
-        fftw_destroy_plan(p);
-        fftw_cleanup_threads();
+    static unsigned planner_flags(const string &planner) {
+        if (planner == "estimate") {
+            return FFTW_ESTIMATE;
+        } else if (planner == "measure") {
+            return FFTW_MEASURE;
+        } else if (planner == "patient") {
+            return FFTW_PATIENT;
+        } else if (planner == "exhaustive") {
+            return FFTW_EXHAUSTIVE;
+        }
+        throw runtime_error("fftw: unknown planner '" + planner + "'");
+    }
+
+    // Returns the planner of the FFTW extension methods, which is created on demand
+    static shared_ptr<Planner> instance() {
+        static weak_ptr<Planner> planner;
+        shared_ptr<Planner> ret = planner.lock();
+        if (not ret) {
+            ConfigParser config(-1);
+            ret = make_shared<Planner>(config.defaultGet<string>("fftw", "cache_dir", ""),
+                                       config.defaultGet<string>("fftw", "planner", "estimate"));
+            planner = ret;
+        }
+        return ret;
+    }
+};
+
+// Returns the data pointer of 'view'
+inline char *data_ptr(const bh_view &view, size_t elem_size) {
+    return (char *) view.base->data + view.start * elem_size;
+}
+
+// Returns the strides of a contiguous array with the shape of 'view'
+vector<int64_t> contiguous_stride(const bh_view &view) {
+    vector<int64_t> ret(view.ndim);
+    int64_t stride = 1;
+    for (int64_t d = view.ndim - 1; d >= 0; --d) {
+        ret[d] = stride;
+        stride *= view.shape[d];
+    }
+    return ret;
+}
+
+// Calls 'func(i, offset)' for the elements of 'view' in row-major order where 'i' is the index of the element and
+// 'offset' is its offset from the start of 'view'
+template<typename Func>
+void for_each_element(const bh_view &view, Func func) {
+    const int64_t nelem = bh_nelements(view);
+    int64_t coord[BH_MAXDIM] = {0};
+    int64_t offset = 0;
+    for (int64_t i = 0; i < nelem; ++i) {
+        func(i, offset);
+        // Increment the coordinate of the last dimension and carry to the preceding dimensions
+        for (int64_t d = view.ndim - 1; d >= 0; --d) {
+            offset += view.stride[d];
+            if (++coord[d] < view.shape[d]) {
+                break;
+            }
+            offset -= view.shape[d] * view.stride[d];
+            coord[d] = 0;
+        }
+    }
+}
+
+// Copy 'view', whose elements consist of 'ncomp' values of type 'In', into the contiguous 'out' buffer
+template<typename In, typename Out>
+void copy_to_contiguous(const bh_view &view, int ncomp, Out *out) {
+    const In *in = (const In *) view.base->data + ncomp * view.start;
+    for_each_element(view, [&](int64_t i, int64_t offset) {
+        for (int c = 0; c < ncomp; ++c) {
+            out[ncomp * i + c] = static_cast<Out>(in[ncomp * offset + c]);
+        }
+    });
+}
+
+// Copy the contiguous 'in' buffer into 'view', whose elements consist of 'ncomp' values of type 'Out'
+template<typename In, typename Out>
+void copy_from_contiguous(const In *in, int ncomp, const bh_view &view) {
+    Out *out = (Out *) view.base->data + ncomp * view.start;
+    for_each_element(view, [&](int64_t i, int64_t offset) {
+        for (int c = 0; c < ncomp; ++c) {
+            out[ncomp * offset + c] = static_cast<Out>(in[ncomp * i + c]);
+        }
+    });
+}
+
+template<Kind kind>
+class Impl : public ExtmethodImpl {
+    shared_ptr<Planner> _planner = Planner::instance();
+
+    // The number of values of each element of the input and the output
+    static constexpr int in_ncomp = kind == Kind::R2C ? 1 : 2;
+    static constexpr int out_ncomp = kind == Kind::C2R ? 1 : 2;
+
+    // Transform 'in' into 'out', which point to the first element of arrays with the given strides, where 'shape' is
+    // the shape of the real array (or the complex array of C2C)
+    template<typename Real>
+    void transform(PlanCache<Real> &plans, vector<int64_t> shape, void *in, vector<int64_t> in_stride, void *out,
+                   vector<int64_t> out_stride, int sign) {
+        PlanKey key;
+        key.kind = kind;
+        key.sign = kind == Kind::C2C ? sign : 0;
+        key.nthreads = omp_get_max_threads();
+        key.shape = move(shape);
+        key.in_stride = move(in_stride);
+        key.out_stride = move(out_stride);
+        key.in_place = in == out;
+        key.aligned = Fftw<Real>::aligned(in) and Fftw<Real>::aligned(out);
+        Fftw<Real>::execute(kind, plans.get(key), in, out);
+    }
+
+    template<typename Real>
+    void transform(PlanCache<Real> &plans, const bh_view &in, const bh_view &out, int sign) {
+        const bh_view &real = kind == Kind::C2R ? out : in;
+        void *i = data_ptr(in, in_ncomp * sizeof(Real));
+        vector<int64_t> in_stride(in.stride, in.stride + in.ndim);
+        if (kind == Kind::C2R) {
+            // FFTW overwrites the input of multi-dimensional C2R transforms thus we transform a contiguous copy
+            Real *tmp = (Real *) plans.scratch(bh_nelements(in) * in_ncomp * sizeof(Real));
+            copy_to_contiguous<Real>(in, in_ncomp, tmp);
+            i = tmp;
+            in_stride = contiguous_stride(in);
+        }
+        transform(plans, vector<int64_t>(real.shape, real.shape + real.ndim), i, move(in_stride),
+                  data_ptr(out, out_ncomp * sizeof(Real)), vector<int64_t>(out.stride, out.stride + out.ndim), sign);
+    }
+
+    // Transform the single-precision 'in' into 'out' in double precision through contiguous copies
+    void transform_in_double(PlanCache<double> &plans, const bh_view &in, const bh_view &out, int sign) {
+        const bh_view &real = kind == Kind::C2R ? out : in;
+        vector<double> i(bh_nelements(in) * in_ncomp), o(bh_nelements(out) * out_ncomp);
+        copy_to_contiguous<float>(in, in_ncomp, &i[0]);
+        transform(plans, vector<int64_t>(real.shape, real.shape + real.ndim), &i[0], contiguous_stride(in), &o[0],
+                  contiguous_stride(out), sign);
+        copy_from_contiguous<double, float>(&o[0], out_ncomp, out);
+    }
+
+public:
+    void execute(bh_instruction *instr, void* arg) {
+        const bh_view &out = instr->operand[0];
+        const bh_view &in = instr->operand[1];
+        assert(in.ndim == out.ndim);
+        int sign = 0;
+        if (kind == Kind::C2C) {
+            const bh_int32 *args = (bh_int32 *) instr->operand[2].base->data;
+            assert(args != NULL);
+            assert(instr->operand[2].base->nelem == 1);
+            sign = args[0];
+        }
+        // The shape of the real array and the complex array, which is halved in the last dimension
+        const bh_view &real = kind == Kind::C2R ? out : in;
+        const bh_view &cplx = kind == Kind::R2C ? out : in;
+        for (int64_t d = 0; d < in.ndim; ++d) {
+            const int64_t n = (d + 1 == in.ndim and kind != Kind::C2C) ? real.shape[d] / 2 + 1 : real.shape[d];
+            if (cplx.shape[d] != n) {
+                throw runtime_error("fftw: the shape of the input and output does not match");
+            }
+        }
+
+        //Make sure that the arrays memory are allocated.
+        bh_data_malloc(out.base);
+        bh_data_malloc(in.base);
+
+        const bh_type real_type = kind == Kind::C2C ? bh_type::BOOL : real.base->type;
+        if (cplx.base->type == bh_type::COMPLEX128 and (kind == Kind::C2C or real_type == bh_type::FLOAT64)) {
+            transform(_planner->plans64, in, out, sign);
+#ifdef BH_FFTW_FLOAT
+        } else if (cplx.base->type == bh_type::COMPLEX64 and (kind == Kind::C2C or real_type == bh_type::FLOAT32)) {
+            transform(_planner->plans32, in, out, sign);
+        } else {
+            throw runtime_error("fftw: DTYPE must be complex128 (float64) or complex64 (float32)");
+#else
+        } else if (cplx.base->type == bh_type::COMPLEX64 and (kind == Kind::C2C or real_type == bh_type::FLOAT32)) {
+            // Bohrium was built without the single-precision FFTW
+            transform_in_double(_planner->plans64, in, out, sign);
+        } else {
+            throw runtime_error("fftw: DTYPE must be complex128 (float64) or complex64 (float32)");
+#endif
+        }
     }
 };
 } // Unnamed namespace
 
 extern "C" ExtmethodImpl* fftw_create() {
-    return new Impl();
+    return new Impl<Kind::C2C>();
 }
 extern "C" void fftw_destroy(ExtmethodImpl* self) {
     delete self;
 }
+extern "C" ExtmethodImpl* fftw_r2c_create() {
+    return new Impl<Kind::R2C>();
+}
+extern "C" void fftw_r2c_destroy(ExtmethodImpl* self) {
+    delete self;
+}
+extern "C" ExtmethodImpl* fftw_c2r_create() {
+    return new Impl<Kind::C2R>();
+}
+extern "C" void fftw_c2r_destroy(ExtmethodImpl* self) {
+    delete self;
+}
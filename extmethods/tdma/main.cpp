@@ -19,6 +19,7 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 #include <stdexcept>
 #include <cassert>
+#include <vector>
 
 #include <bh_extmethod.hpp>
 
@@ -27,50 +28,133 @@ using namespace extmethod;
 using namespace std;
 
 namespace {
+
+// The number of systems we solve in lockstep, which is the number of lanes in a 256-bit SIMD register
+template<typename T>
+constexpr int64_t simd_width() {
+    return 32 / sizeof(T);
+}
+
+// Returns a scratch buffer of at least 'nelem' elements that is private to the calling thread and reused between
+// calls, which saves a malloc per call
+template<typename T>
+T *scratch_arena(size_t nelem) {
+    static thread_local vector<T> arena;
+    if (arena.size() < nelem) {
+        arena.resize(nelem);
+    }
+    return arena.data();
+}
+
+// The location of 'm' systems of size 'n'. The element 'j' of the system 'i' in array 'x' is at
+// `x[i * x_sys + j * x_elem]` where the lower diagonal 'a', the diagonal 'b', and the upper diagonal 'c' share strides.
+template<typename T>
+struct Systems {
+    const T *a, *b, *c, *d;
+    T *x;
+    int64_t diag_sys, diag_elem, rhs_sys, rhs_elem, out_sys, out_elem;
+    int64_t m, n;
+};
+
 class TDMAImpl : public ExtmethodImpl {
 private:
-    template<typename T>
-    void tdma(const T* a, const T* b, const T* c, const T* d, T* c_prime, T* d_prime, const int n) const
+    // Solve the 'W' systems starting at 'first' in lockstep using the scratch buffers 'c_prime' and 'd_prime' of
+    // 'W * n' elements. The lanes of the scratch buffers are interleaved thus each step of the Thomas algorithm is
+    // a SIMD operation over the 'W' systems, which also hides the latency of the division.
+    // When 'interleaved', the systems are next to each other in all arrays, which makes the SIMD loads contiguous.
+    // See https://en.wikipedia.org/wiki/Tridiagonal_matrix_algorithm
+    template<typename T, int64_t W, bool interleaved>
+    void tdma(const Systems<T> &s, int64_t first, T *c_prime, T *d_prime) const
     {
-      // See https://en.wikipedia.org/wiki/Tridiagonal_matrix_algorithm
-      c_prime[0] = c[0] / b[0];
-      d_prime[0] = d[0] / b[0];
-      for(int i=1; i < n; ++i)
+      const int64_t diag_sys = interleaved ? 1 : s.diag_sys;
+      const int64_t rhs_sys = interleaved ? 1 : s.rhs_sys;
+      const int64_t out_sys = interleaved ? 1 : s.out_sys;
+      const T *a = s.a + first * diag_sys;
+      const T *b = s.b + first * diag_sys;
+      const T *c = s.c + first * diag_sys;
+      const T *d = s.d + first * rhs_sys;
+      T *x = s.x + first * out_sys;
+
+      #pragma omp simd
+      for(int64_t l=0; l < W; ++l)
+      {
+          c_prime[l] = c[l * diag_sys] / b[l * diag_sys];
+          d_prime[l] = d[l * rhs_sys] / b[l * diag_sys];
+      }
+      for(int64_t i=1; i < s.n; ++i)
+      {
+          const T *ai = a + i * s.diag_elem, *bi = b + i * s.diag_elem, *ci = c + i * s.diag_elem;
+          const T *di = d + i * s.rhs_elem;
+          T *cp = c_prime + i * W, *dp = d_prime + i * W;
+          #pragma omp simd
+          for(int64_t l=0; l < W; ++l)
+          {
+              const T m = T(1) / (bi[l * diag_sys] - ai[l * diag_sys] * cp[l - W]);
+              cp[l] = ci[l * diag_sys] * m;
+              dp[l] = (di[l * rhs_sys] - ai[l * diag_sys] * dp[l - W]) * m;
+          }
+      }
+      T *xi = x + (s.n - 1) * s.out_elem;
+      const T *dp = d_prime + (s.n - 1) * W;
+      #pragma omp simd
+      for(int64_t l=0; l < W; ++l)
       {
-          const T m = 1. / (b[i] - a[i] * c_prime[i-1]);
-          c_prime[i] = c[i] * m;
-          d_prime[i] = (d[i] - a[i] * d_prime[i-1]) * m;
+          xi[l * out_sys] = dp[l];
       }
-      for(int i=n-2; i > -1; --i)
+      for(int64_t i=s.n-2; i > -1; --i)
       {
-          d_prime[i] -= c_prime[i] * d_prime[i+1];
+          const T *cp = c_prime + i * W;
+          T *dpi = d_prime + i * W;
+          xi = x + i * s.out_elem;
+          #pragma omp simd
+          for(int64_t l=0; l < W; ++l)
+          {
+              dpi[l] -= cp[l] * dpi[l + W];
+              xi[l * out_sys] = dpi[l];
+          }
       }
     }
 
     template<typename T>
     void tdma_reduce(const bh_view* diagonals, const bh_view* rhs, bh_view* out) const
     {
-      const int m = rhs->shape[0];
-      const int n = rhs->shape[1];
-      T* tmp = (T*) malloc(n * m * sizeof(T));
-      T *a = (T*) diagonals->base->data + diagonals->start;
-      T *b = (T*) diagonals->base->data + diagonals->start + diagonals->stride[0];
-      T *c = (T*) diagonals->base->data + diagonals->start + 2*diagonals->stride[0];
-      T *r = (T*) rhs->base->data + rhs->start;
-      T *o = (T*) out->base->data + out->start;
-
-      #pragma omp parallel for
-      for(int i=0; i < m; ++i)
+      Systems<T> s;
+      s.a = (T*) diagonals->base->data + diagonals->start;
+      s.b = s.a + diagonals->stride[0];
+      s.c = s.b + diagonals->stride[0];
+      s.d = (T*) rhs->base->data + rhs->start;
+      s.x = (T*) out->base->data + out->start;
+      s.diag_sys = diagonals->stride[1];
+      s.diag_elem = diagonals->stride[2];
+      s.rhs_sys = rhs->stride[0];
+      s.rhs_elem = rhs->stride[1];
+      s.out_sys = out->stride[0];
+      s.out_elem = out->stride[1];
+      s.m = rhs->shape[0];
+      s.n = rhs->shape[1];
+
+      // Groups of 'W' systems are solved in lockstep and the remaining systems one at a time
+      constexpr int64_t W = simd_width<T>();
+      const int64_t ngroups = s.m / W;
+      const bool interleaved = s.diag_sys == 1 and s.rhs_sys == 1 and s.out_sys == 1;
+      #pragma omp parallel
       {
-          tdma(a + i * diagonals->stride[1],
-               b + i * diagonals->stride[1],
-               c + i * diagonals->stride[1],
-               r + i * rhs->stride[0],
-               tmp + i * n,
-               o + i * out->stride[0],
-               n);
+          T *scratch = scratch_arena<T>(2 * W * s.n);
+          #pragma omp for schedule(static) nowait
+          for(int64_t g=0; g < ngroups; ++g)
+          {
+              if (interleaved) {
+                  tdma<T, W, true>(s, g * W, scratch, scratch + W * s.n);
+              } else {
+                  tdma<T, W, false>(s, g * W, scratch, scratch + W * s.n);
+              }
+          }
+          #pragma omp for schedule(static)
+          for(int64_t i=ngroups * W; i < s.m; ++i)
+          {
+              tdma<T, 1, false>(s, i, scratch, scratch + s.n);
+          }
       }
-      free(tmp);
     }
 
 public:
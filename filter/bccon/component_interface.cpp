@@ -19,6 +19,7 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <bh_component.hpp>
+#include <bh_extmethod.hpp>
 #include "contracter.hpp"
 
 using namespace bohrium;
@@ -29,6 +30,24 @@ namespace {
 class Impl : public ComponentImplWithChild {
 private:
     filter::bccon::Contracter contractor;
+    // The extension methods that the bridge or this filter registered, BH_NONE marks unavailable methods
+    map<string, bh_opcode> extmethods;
+    // The opcode of the next extension method this filter registers, which is far from the opcodes of the bridge
+    bh_opcode next_extmethod_opcode = BH_MAX_OPCODE_ID + (1 << 16);
+
+    bh_opcode extmethod_opcode(const string &name) {
+        auto it = extmethods.find(name);
+        if (it != extmethods.end()) {
+            return it->second;
+        }
+        bh_opcode ret = BH_NONE;
+        try {
+            child.extmethod(name, next_extmethod_opcode);
+            ret = next_extmethod_opcode++;
+        } catch (const extmethod::ExtmethodNotFound &) {}
+        extmethods[name] = ret;
+        return ret;
+    }
 public:
     Impl(int stack_level) : ComponentImplWithChild(stack_level),
                             contractor(config.defaultGet<bool>("verbose", false),
@@ -36,13 +55,19 @@ public:
                                        config.defaultGet<bool>("reduction", false),
                                        config.defaultGet<bool>("stupidmath", false),
                                        config.defaultGet<bool>("collect", false),
-                                       config.defaultGet<bool>("muladd", false)) {};
+                                       config.defaultGet<bool>("muladd", false),
+                                       config.defaultGet<bool>("matmul", false),
+                                       [this](const string &name) { return extmethod_opcode(name); }) {};
 
     ~Impl() {}; // NB: a destructor implementation must exist
     void execute(bh_ir *bhir) {
         contractor.contract(*bhir);
         child.execute(bhir);
     };
+    void extmethod(const string &name, bh_opcode opcode) {
+        child.extmethod(name, opcode);
+        extmethods[name] = opcode;
+    };
 };
 } //Unnamed namespace
 
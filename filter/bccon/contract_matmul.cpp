@@ -0,0 +1,281 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "contracter.hpp"
+
+#include <bh_component.hpp>
+#include <bh_util.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace filter {
+namespace bccon {
+
+namespace {
+
+// Below this number of multiply-adds, the JIT-compiled loop is cheaper than the BLAS call and the split of the flush
+constexpr int64_t MATMUL_MIN_WORK = 1 << 15;
+
+// Returns true when 'view' is the same element along 'axis' (-1 is a non-existing axis)
+bool is_broadcast(const bh_view &view, int64_t axis) {
+    return axis < 0 or view.shape[axis] == 1 or view.stride[axis] == 0;
+}
+
+// Returns the matrix of 'view' that has the axes 'row' and 'col' (-1 is a non-existing axis of size one)
+bh_view matrix(const bh_view &view, int64_t row, int64_t col) {
+    bh_view ret;
+    ret.base = view.base;
+    ret.start = view.start;
+    ret.ndim = 2;
+    ret.shape[0] = row < 0 ? 1 : view.shape[row];
+    ret.stride[0] = row < 0 ? 0 : view.stride[row];
+    ret.shape[1] = col < 0 ? 1 : view.shape[col];
+    ret.stride[1] = col < 0 ? 0 : view.stride[col];
+    return ret;
+}
+
+// Returns true when 'instr' writes to 'base'
+bool writes(const bh_instruction &instr, const bh_base *base) {
+    if (instr.opcode > BH_MAX_OPCODE_ID) {
+        for (const bh_view &view: instr.operand) {
+            if (not bh_is_constant(&view) and view.base == base) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return not instr.operand.empty() and instr.opcode != BH_SYNC and instr.operand[0].base == base;
+}
+
+// The matrix product C = A * B where the matrices are 2-D views
+struct Matmul {
+    bh_view C, A, B;
+
+    // The number of operands that are not contiguous thus must be copied before calling BLAS
+    int ncopies() const {
+        return (bh_is_contiguous(&C) ? 0 : 1) + (bh_is_contiguous(&A) ? 0 : 1) + (bh_is_contiguous(&B) ? 0 : 1);
+    }
+
+    // Returns the transposed product C^T = B^T * A^T
+    Matmul transposed() const {
+        Matmul ret;
+        ret.C = matrix(C, 1, 0);
+        ret.A = matrix(B, 1, 0);
+        ret.B = matrix(A, 1, 0);
+        return ret;
+    }
+};
+
+// Returns a contiguous copy of 'view' in a new temporary base array, which is appended to 'temp_bases'
+bh_view contiguous_temp(const bh_view &view, vector<unique_ptr<bh_base> > &temp_bases) {
+    unique_ptr<bh_base> base(new bh_base());
+    base->data = nullptr;
+    base->type = view.base->type;
+    base->nelem = view.shape[0] * view.shape[1];
+    bh_view ret = matrix(view, 0, 1);
+    ret.base = base.get();
+    ret.start = 0;
+    ret.stride[0] = ret.shape[1];
+    ret.stride[1] = 1;
+    temp_bases.push_back(std::move(base));
+    return ret;
+}
+
+// Returns the index of the instruction that frees 'base' when only the instructions at 'pc1' and 'pc2' access
+// 'base' otherwise, or zero when other instructions access 'base'
+size_t only_freed_after(const bh_ir &bhir, const bh_base *base, size_t pc1, size_t pc2) {
+    size_t ret = 0;
+    for (size_t pc = 0; pc < bhir.instr_list.size(); ++pc) {
+        const bh_instruction &instr = bhir.instr_list[pc];
+        if (pc == pc1 or pc == pc2 or instr.opcode == BH_NONE) {
+            continue;
+        }
+        for (const bh_view &view: instr.operand) {
+            if (not bh_is_constant(&view) and view.base == base) {
+                if (instr.opcode != BH_FREE or pc < pc2 or ret != 0) {
+                    return 0;
+                }
+                ret = pc;
+            }
+        }
+    }
+    return ret;
+}
+}
+
+/*
+We are looking for matrix products written as a broadcasted multiplication followed by a sum over the shared axis:
+
+  BH_MULTIPLY t a[:, :, None] b[None, :, :]
+  BH_ADD_REDUCE c t 1
+  BH_FREE t
+
+which might arise from the following math:
+
+  c = sum(a[:, :, None] * b[None, :, :], axis=1)
+
+or `add.reduce(a[:, None] * b.T, -1)` and `add.reduce(a * x, -1)`, which are the matrix-matrix and matrix-vector
+products of the NumPy bridge. We rewrite them into the BLAS extension method:
+
+  BLAS_GEMM c a b
+
+Inputs and outputs that are transposed or strided are copied into contiguous temporary arrays when the transposed
+product C^T = B^T * A^T doesn't avoid the copy.
+*/
+void Contracter::contract_matmul(bh_ir &bhir)
+{
+    bh_opcode gemm = BH_NONE;
+    // The replacements of the reductions and the instructions to remove
+    map<size_t, vector<bh_instruction> > replacements;
+    set<size_t> removals;
+
+    for(size_t pc = 0; pc < bhir.instr_list.size(); ++pc) {
+        const bh_instruction &mul = bhir.instr_list[pc];
+        if (mul.opcode != BH_MULTIPLY or bh_is_constant(&mul.operand[1]) or bh_is_constant(&mul.operand[2])) {
+            continue;
+        }
+        const bh_view &T = mul.operand[0];
+        const bh_type type = T.base->type;
+        if ((T.ndim != 2 and T.ndim != 3) or T.base->data != nullptr or util::exist(removals, pc)) {
+            continue;
+        }
+        if (not (type == bh_type::FLOAT32 or type == bh_type::FLOAT64 or
+                 type == bh_type::COMPLEX64 or type == bh_type::COMPLEX128)) {
+            continue;
+        }
+        if (mul.operand[1].base->type != type or mul.operand[2].base->type != type) {
+            continue;
+        }
+
+        // Find the sum of 't' over one of its axes
+        size_t pc2 = pc + 1;
+        for (; pc2 < bhir.instr_list.size(); ++pc2) {
+            const bh_instruction &instr = bhir.instr_list[pc2];
+            if (instr.opcode == BH_ADD_REDUCE and instr.operand[1] == T) {
+                break;
+            }
+            // The inputs must be unchanged when we multiply at the reduction
+            if (writes(instr, mul.operand[1].base) or writes(instr, mul.operand[2].base)) {
+                pc2 = bhir.instr_list.size();
+            }
+        }
+        if (pc2 >= bhir.instr_list.size()) {
+            continue;
+        }
+        const bh_instruction &sum = bhir.instr_list[pc2];
+        const bh_view &out = sum.operand[0];
+        const int64_t axis = sum.constant.get_int64();
+        if (axis < 0 or axis >= T.ndim or out.base->type != type or util::exist(replacements, pc2)) {
+            continue;
+        }
+        if (out.base == mul.operand[1].base or out.base == mul.operand[2].base) {
+            continue;
+        }
+        const size_t pc_free = only_freed_after(bhir, T.base, pc, pc2);
+        if (pc_free == 0) {
+            continue;
+        }
+
+        // The axes of the output matrix are the axes of 't' except the summed one
+        vector<int64_t> axes;
+        for (int64_t i = 0; i < T.ndim; ++i) {
+            if (i != axis) {
+                axes.push_back(i);
+            }
+        }
+        const int64_t row = axes[0];
+        const int64_t col = axes.size() > 1 ? axes[1] : -1;
+
+        // 'A' is the same along the columns and 'B' is the same along the rows
+        const bh_view *A, *B;
+        if (is_broadcast(mul.operand[1], col) and is_broadcast(mul.operand[2], row)) {
+            A = &mul.operand[1];
+            B = &mul.operand[2];
+        } else if (is_broadcast(mul.operand[2], col) and is_broadcast(mul.operand[1], row)) {
+            A = &mul.operand[2];
+            B = &mul.operand[1];
+        } else {
+            continue;
+        }
+        const int64_t ncols = col < 0 ? 1 : T.shape[col];
+        if (T.shape[row] * ncols * T.shape[axis] < MATMUL_MIN_WORK) {
+            continue;
+        }
+
+        // We only need the extension method when we find a match
+        if (gemm == BH_NONE) {
+            gemm = extmethod_opcode_("blas_gemm");
+            if (gemm == BH_NONE) {
+                return;
+            }
+        }
+        Matmul prod;
+        prod.C = matrix(out, 0, col < 0 ? -1 : 1);
+        prod.A = matrix(*A, row, axis);
+        prod.B = matrix(*B, axis, col);
+        if (prod.transposed().ncopies() < prod.ncopies()) {
+            prod = prod.transposed();
+        }
+        verbose_print("[Matmul] Rewriting " + to_string(prod.C.shape[0]) + "x" + to_string(prod.A.shape[1]) +
+                      " times " + to_string(prod.A.shape[1]) + "x" + to_string(prod.C.shape[1]) + " with " +
+                      to_string(prod.ncopies()) + " copies");
+
+        vector<bh_instruction> &instrs = replacements[pc2];
+        vector<bh_view> temps;
+        for (bh_view *view: {&prod.A, &prod.B}) {
+            if (not bh_is_contiguous(view)) {
+                temps.push_back(contiguous_temp(*view, temp_bases_));
+                instrs.push_back(bh_instruction(BH_IDENTITY, {temps.back(), *view}));
+                *view = temps.back();
+            }
+        }
+        const bh_view C = prod.C;
+        if (not bh_is_contiguous(&prod.C)) {
+            temps.push_back(contiguous_temp(prod.C, temp_bases_));
+            prod.C = temps.back();
+        }
+        instrs.push_back(bh_instruction(gemm, {prod.C, prod.A, prod.B}));
+        if (prod.C.base != C.base) {
+            instrs.push_back(bh_instruction(BH_IDENTITY, {C, prod.C}));
+        }
+        for (const bh_view &temp: temps) {
+            instrs.push_back(bh_instruction(BH_FREE, {temp}));
+        }
+        removals.insert(pc);
+        removals.insert(pc_free);
+    }
+
+    if (replacements.empty()) {
+        return;
+    }
+    vector<bh_instruction> instr_list;
+    for(size_t pc = 0; pc < bhir.instr_list.size(); ++pc) {
+        auto it = replacements.find(pc);
+        if (it != replacements.end()) {
+            instr_list.insert(instr_list.end(), it->second.begin(), it->second.end());
+        } else if (not util::exist(removals, pc)) {
+            instr_list.push_back(std::move(bhir.instr_list[pc]));
+        }
+    }
+    bhir.instr_list = std::move(instr_list);
+}
+
+}}}
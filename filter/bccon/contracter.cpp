@@ -32,12 +32,16 @@ Contracter::Contracter(
     bool reduction,
     bool stupidmath,
     bool collect,
-    bool muladd)
+    bool muladd,
+    bool matmul,
+    std::function<bh_opcode(const std::string &name)> extmethod_opcode)
     : repeats_(repeats),
       reduction_(reduction),
       stupidmath_(stupidmath),
       collect_(collect),
-      muladd_(muladd) {
+      muladd_(muladd),
+      matmul_(matmul),
+      extmethod_opcode_(extmethod_opcode) {
             __verbose = verbose;
       }
 
@@ -45,10 +49,14 @@ Contracter::~Contracter(void) {}
 
 void Contracter::contract(bh_ir& bhir)
 {
+    // The child is done with the temporary arrays of the previous flush
+    temp_bases_.clear();
+
     if(reduction_)  contract_reduction(bhir);
     if(stupidmath_) contract_stupidmath(bhir);
     if(collect_)    contract_collect(bhir);
     if(muladd_)     contract_muladd(bhir);
+    if(matmul_)     contract_matmul(bhir);
     if(repeats_)    contract_repeats(bhir);
 }
 
@@ -1,6 +1,8 @@
 #ifndef __BH_FILTER_COMPOSITE_CONTRACTER
 #define __BH_FILTER_COMPOSITE_CONTRACTER
 
+#include <functional>
+#include <memory>
 #include <bh_component.hpp>
 
 namespace bohrium {
@@ -13,7 +15,8 @@ extern void verbose_print(std::string str);
 class Contracter
 {
 public:
-    Contracter(bool verbose, bool repeats, bool reduction, bool stupidmath, bool collect, bool muladd);
+    Contracter(bool verbose, bool repeats, bool reduction, bool stupidmath, bool collect, bool muladd, bool matmul,
+               std::function<bh_opcode(const std::string &name)> extmethod_opcode);
 
     ~Contracter(void);
 
@@ -24,12 +27,18 @@ public:
     void contract_stupidmath(bh_ir& bhir);
     void contract_collect(bh_ir& bhir);
     void contract_muladd(bh_ir& bhir);
+    void contract_matmul(bh_ir& bhir);
 private:
     bool repeats_;
     bool reduction_;
     bool stupidmath_;
     bool collect_;
     bool muladd_;
+    bool matmul_;
+    // Returns the opcode of the extension method 'name' or BH_NONE when it isn't available
+    std::function<bh_opcode(const std::string &name)> extmethod_opcode_;
+    // The temporary base arrays of the rewrites of the previous flush
+    std::vector<std::unique_ptr<bh_base> > temp_bases_;
 };
 
 }}}
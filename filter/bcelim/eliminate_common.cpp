@@ -0,0 +1,213 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include <bh_util.hpp>
+
+#include "eliminator.hpp"
+
+using namespace std;
+
+namespace bohrium {
+namespace filter {
+namespace bcelim {
+
+namespace {
+
+bool is_extmethod(const bh_instruction &instr)
+{
+    return instr.opcode > BH_MAX_OPCODE_ID;
+}
+
+template <typename T>
+void append(string &key, const T &value)
+{
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void append_view(string &key, const bh_view &view, uint64_t version)
+{
+    append(key, view.base);
+    append(key, version);
+    append(key, view.start);
+    append(key, view.ndim);
+    for (int64_t i = 0; i < view.ndim; ++i) {
+        append(key, view.shape[i]);
+        append(key, view.stride[i]);
+    }
+}
+
+// Returns the key of the computation of 'instr', which identifies the opcode, the shape and type of the output,
+// the input views, and the constant. 'version' counts the writes to each base array, thus the key of a
+// computation changes when one of its inputs is overwritten.
+string computation_key(const bh_instruction &instr, map<const bh_base*, uint64_t> &version)
+{
+    string key;
+    append(key, instr.opcode);
+    append(key, instr.operand[0].base->type);
+    append(key, instr.operand[0].ndim);
+    for (int64_t i = 0; i < instr.operand[0].ndim; ++i) {
+        append(key, instr.operand[0].shape[i]);
+    }
+    for (size_t i = 1; i < instr.operand.size(); ++i) {
+        const bh_view &view = instr.operand[i];
+        if (bh_is_constant(&view)) {
+            append(key, i);
+            append(key, instr.constant.type);
+            key.append(reinterpret_cast<const char*>(&instr.constant.value), bh_type_size(instr.constant.type));
+        } else {
+            append_view(key, view, version[view.base]);
+        }
+    }
+    return key;
+}
+
+// Is 'view' the whole of its base array in contiguous order?
+bool is_whole_base(const bh_view &view)
+{
+    return view.start == 0 and bh_is_contiguous(&view) and bh_nelements(view) == view.base->nelem;
+}
+
+// Is 'base' written or freed by 'instr'?
+bool writes_or_frees(const bh_instruction &instr, const bh_base *base)
+{
+    if (is_extmethod(instr)) {
+        for (const bh_view &view: instr.operand) {
+            if (view.base == base) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if (instr.opcode == BH_FREE) {
+        return instr.operand[0].base == base;
+    }
+    return not bh_opcode_is_system(instr.opcode) and instr.operand[0].base == base;
+}
+
+}
+
+// Eliminates instructions that recompute the value of a previous instruction. The output base array of the
+// eliminated instruction must be a temporary array of this flush, which we rename to the output base array
+// of the previous instruction. Thus, the following instructions read the previous result directly.
+uint64_t Eliminator::eliminate_common(bh_ir& bhir, uint64_t& work)
+{
+    vector<bh_instruction> &instr_list = bhir.instr_list;
+
+    // The first instruction that accesses each base array and the instruction that frees it
+    map<const bh_base*, size_t> first_access, free_index;
+    set<const bh_base*> synced;
+    for (size_t i = 0; i < instr_list.size(); ++i) {
+        const bh_instruction &instr = instr_list[i];
+        for (const bh_view &view: instr.operand) {
+            if (not bh_is_constant(&view)) {
+                first_access.insert(make_pair(view.base, i));
+            }
+        }
+        if (instr.opcode == BH_FREE) {
+            free_index[instr.operand[0].base] = i;
+        } else if (instr.opcode == BH_SYNC) {
+            synced.insert(instr.operand[0].base);
+        }
+    }
+
+    // Can we replace the output base array of 'instr_list[idx]' with the output of 'prev'?
+    auto renamable = [&](size_t idx, const bh_instruction &prev) -> bool {
+        const bh_view &out = instr_list[idx].operand[0];
+        const bh_view &prev_out = prev.operand[0];
+        if (out.base->data != nullptr or first_access.at(out.base) != idx or util::exist(synced, out.base)) {
+            return false;
+        }
+        auto free_it = free_index.find(out.base);
+        if (free_it == free_index.end() or out.base->type != prev_out.base->type or
+            out.base->nelem != prev_out.base->nelem or not is_whole_base(out) or not is_whole_base(prev_out)) {
+            return false;
+        }
+        // Both arrays must keep their value until the temporary array is freed
+        for (size_t i = idx + 1; i < free_it->second; ++i) {
+            if (writes_or_frees(instr_list[i], out.base) or writes_or_frees(instr_list[i], prev_out.base)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    uint64_t ret = 0;
+    map<const bh_base*, uint64_t> version;
+    // Maps a computation key to the instruction that computed it and the version of its output
+    unordered_map<string, pair<size_t, uint64_t> > values;
+    for (size_t i = 0; i < instr_list.size(); ++i) {
+        bh_instruction &instr = instr_list[i];
+        if (instr.opcode == BH_FREE) {
+            ++version[instr.operand[0].base];
+            continue;
+        }
+        if (bh_opcode_is_system(instr.opcode)) {
+            continue;
+        }
+        if (is_extmethod(instr)) {
+            for (const bh_view &view: instr.operand) {
+                if (not bh_is_constant(&view)) {
+                    ++version[view.base];
+                }
+            }
+            continue;
+        }
+
+        // NB: scatters only write some of the output elements
+        const bool pure = instr.opcode != BH_SCATTER and instr.opcode != BH_COND_SCATTER;
+        string key;
+        if (pure) {
+            key = computation_key(instr, version);
+            auto it = values.find(key);
+            if (it != values.end()) {
+                const bh_instruction &prev = instr_list[it->second.first];
+                bh_base *prev_base = prev.operand[0].base;
+                if (version[prev_base] == it->second.second and renamable(i, prev)) {
+                    bh_base *base = instr.operand[0].base;
+                    const size_t free_idx = free_index.at(base);
+                    for (size_t j = i + 1; j < free_idx; ++j) {
+                        for (bh_view &view: instr_list[j].operand) {
+                            if (view.base == base) {
+                                view.base = prev_base;
+                            }
+                        }
+                    }
+                    work += bh_nelements(instr.operand[0]);
+                    instr.opcode = BH_NONE;
+                    instr_list[free_idx].opcode = BH_NONE;
+                    ++ret;
+                    continue;
+                }
+            }
+        }
+        ++version[instr.operand[0].base];
+        if (pure) {
+            values[key] = make_pair(i, version[instr.operand[0].base]);
+        }
+    }
+    return ret;
+}
+
+}}}
@@ -0,0 +1,68 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <set>
+
+#include <bh_util.hpp>
+
+#include "eliminator.hpp"
+
+using namespace std;
+
+namespace bohrium {
+namespace filter {
+namespace bcelim {
+
+// Eliminates instructions that write to base arrays that are freed in this flush without being read or synced.
+// We scan backwards thus a base array is dead from its BH_FREE back to its last read.
+uint64_t Eliminator::eliminate_dead(bh_ir& bhir, uint64_t& work)
+{
+    vector<bh_instruction> &instr_list = bhir.instr_list;
+    uint64_t ret = 0;
+    set<const bh_base*> dead;
+    for (auto it = instr_list.rbegin(); it != instr_list.rend(); ++it) {
+        bh_instruction &instr = *it;
+        if (instr.opcode == BH_FREE) {
+            dead.insert(instr.operand[0].base);
+        } else if (instr.opcode == BH_SYNC) {
+            dead.erase(instr.operand[0].base);
+        } else if (bh_opcode_is_system(instr.opcode)) {
+            continue;
+        } else if (instr.opcode > BH_MAX_OPCODE_ID) {
+            // Extension methods might read all of their operands
+            for (const bh_view &view: instr.operand) {
+                dead.erase(view.base);
+            }
+        } else if (util::exist(dead, instr.operand[0].base)) {
+            work += bh_nelements(instr.operand[0]);
+            instr.opcode = BH_NONE;
+            ++ret;
+        } else {
+            for (size_t i = 1; i < instr.operand.size(); ++i) {
+                if (not bh_is_constant(&instr.operand[i])) {
+                    dead.erase(instr.operand[i].base);
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+}}}
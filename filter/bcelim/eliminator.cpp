@@ -0,0 +1,79 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <algorithm>
+
+#include "eliminator.hpp"
+
+using namespace std;
+
+namespace bohrium {
+namespace filter {
+namespace bcelim {
+
+Eliminator::Eliminator(bool verbose, bool timing, bool common, bool dead)
+    : verbose_(verbose),
+      timing_(timing),
+      common_(common),
+      dead_(dead) {}
+
+Eliminator::~Eliminator(void)
+{
+    if (timing_) {
+        cout << "[Eliminator] Common subexpressions: " << num_common_ << endl;
+        cout << "[Eliminator] Dead instructions:     " << num_dead_ << endl;
+        cout << "[Eliminator] Eliminated work:       " << work_ << " elements" << endl;
+        cout << "[Eliminator] Time:                  " << time_ << "s" << endl;
+    }
+}
+
+void Eliminator::eliminate(bh_ir& bhir)
+{
+    // NB: we leave the nested instruction lists of BH_REPEAT alone
+    for (const bh_instruction &instr: bhir.instr_list) {
+        if (instr.opcode == BH_REPEAT) {
+            return;
+        }
+    }
+
+    const auto begin = chrono::steady_clock::now();
+    uint64_t work = 0, ncommon = 0, ndead = 0;
+    if (common_) ncommon = eliminate_common(bhir, work);
+    if (dead_)   ndead = eliminate_dead(bhir, work);
+
+    if (ncommon + ndead > 0) {
+        vector<bh_instruction> &instr_list = bhir.instr_list;
+        instr_list.erase(remove_if(instr_list.begin(), instr_list.end(),
+                                   [](const bh_instruction &instr) { return instr.opcode == BH_NONE; }),
+                         instr_list.end());
+    }
+    num_common_ += ncommon;
+    num_dead_ += ndead;
+    work_ += work;
+    time_ += chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    if (verbose_ and ncommon + ndead > 0) {
+        cout << "[Eliminator] Eliminated " << ncommon << " common subexpressions and " << ndead
+             << " dead instructions (" << work << " elements)" << endl;
+    }
+}
+
+}}}
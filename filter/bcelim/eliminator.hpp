@@ -0,0 +1,57 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __BH_FILTER_BCELIM_ELIMINATOR
+#define __BH_FILTER_BCELIM_ELIMINATOR
+
+#include <bh_component.hpp>
+
+namespace bohrium {
+namespace filter {
+namespace bcelim {
+
+class Eliminator
+{
+public:
+    Eliminator(bool verbose, bool timing, bool common, bool dead);
+
+    ~Eliminator(void);
+
+    void eliminate(bh_ir& bhir);
+
+    // Each elimination replaces the eliminated instructions with BH_NONE, adds the number of elements
+    // they would have computed to 'work', and returns the number of eliminated instructions
+    uint64_t eliminate_common(bh_ir& bhir, uint64_t& work);
+    uint64_t eliminate_dead(bh_ir& bhir, uint64_t& work);
+private:
+    bool verbose_;
+    bool timing_;
+    bool common_;
+    bool dead_;
+
+    // Accumulated statistics, which are printed at exit when timing is enabled
+    uint64_t num_common_ = 0;
+    uint64_t num_dead_ = 0;
+    uint64_t work_ = 0;
+    double time_ = 0;
+};
+
+}}}
+#endif
@@ -87,6 +87,13 @@ int64_t bh_base_size(const bh_base *base);
  */
 DLLEXPORT void bh_data_malloc(bh_base* base);
 
+/* Allocate zero initialized data memory for the given base if not already allocated.
+ * For convenience, the base is allowed to be NULL.
+ *
+ * @base    The base in question
+ */
+DLLEXPORT void bh_data_calloc(bh_base* base);
+
 /* Frees data memory for the given view.
  * For convenience, the view is allowed to be NULL.
  *
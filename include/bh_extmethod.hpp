@@ -112,6 +112,9 @@ class ExtmethodFace {
     // Get the extmethod implementation
     ExtmethodImpl* getImpl() { return _implementation; };
 
+    // Get the name of the extmethod
+    const std::string &name() const { return _name; };
+
     /* Execute an instruction
      *
      * @instr The extension method instruction to handle
@@ -35,6 +35,13 @@ extern "C" {
  */
 void* bh_memory_malloc(int64_t size);
 
+/* Allocate an alligned contigous block of zero initialized memory
+ *
+ * @size  The size of the allocated block
+ * @return A pointer to data, and NULL on error
+ */
+void* bh_memory_calloc(int64_t size);
+
 /* Frees a previously allocated data block
  *
  * @data  The pointer returned from a call to bh_memory_malloc
@@ -42,8 +42,9 @@ std::vector<Block> apply_pre_fusion(const std::vector<bh_instruction*> &instr_li
 
 // Apply the list of tranformers specified by the names in 'transformer_names'
 // 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
+// 'fuser_window' bounds the number of blocks the windowed fusers fuse together (zero means unbounded)
 void apply_transformers(std::vector<Block> &block_list, const std::vector<std::string> &transformer_names,
-                        bool avoid_rank0_sweep);
+                        bool avoid_rank0_sweep, uint64_t fuser_window = 0);
 
 // Create a block list based on 'instr_list' and what is in the 'config' and 'fcache'
 // 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
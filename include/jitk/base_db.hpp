@@ -228,6 +228,8 @@ private:
     std::set<bh_view> _scalar_replacements_r; // Set of scalar replaced arrays
     std::set<bh_view> _omp_atomic; // Set of arrays that should be guarded by OpenMP atomic
     std::set<bh_view> _omp_critical; // Set of arrays that should be guarded by OpenMP critical
+    std::set<bh_view> _rotating; // Set of scalar replaced arrays that are rotated between loop iterations
+    std::set<bh_view> _nontemporal; // Set of arrays that should be written using non-temporal stores
     std::set<bh_base*> _declared_base; // Set of bases that have been locally declared (e.g. a temporary variable)
     std::set<bh_view> _declared_view; // Set of views that have been locally declared (e.g. a temporary variable)
     std::set<bh_view, idx_less> _declared_idx; // Set of indexes that have been locally declared
@@ -236,6 +238,8 @@ public:
     const bool use_volatile;
     // Should we use offset and strides as variables?
     const bool strides_as_variables;
+    // Number of iterations to prefetch ahead of gather/scatter accesses (zero disables prefetching)
+    const int64_t prefetch_distance;
 
     template<typename T1, typename T2>
     Scope(const SymbolTable &symbols,
@@ -245,7 +249,8 @@ public:
           const T2 &scalar_replacements_r,
           const ConfigParser &config) : symbols(symbols), parent(parent),
                                         use_volatile(config.defaultGet<bool>("volatile", false)),
-                                        strides_as_variables(config.defaultGet<bool>("strides_as_var", true)) {
+                                        strides_as_variables(config.defaultGet<bool>("strides_as_var", true)),
+                                        prefetch_distance(config.defaultGet<int64_t>("prefetch_distance", 0)) {
         for(const bh_base* base: tmps) {
             if (not symbols.isAlwaysArray(base))
                 _tmps.insert(base);
@@ -348,6 +353,34 @@ public:
         }
     }
 
+    // Insert and check if 'view' is a register that is rotated between iterations (a sliding window)
+    void insertRotating(const bh_view &view) {
+        _rotating.insert(view);
+    }
+    bool isRotating(const bh_view &view) const {
+        if (_rotating.find(view) != _rotating.end()) {
+            return true;
+        } else if (parent != NULL) {
+            return parent->isRotating(view);
+        } else {
+            return false;
+        }
+    }
+
+    // Insert and check if 'view' should be written using non-temporal (streaming) stores
+    void insertNontemporal(const bh_view &view) {
+        _nontemporal.insert(view);
+    }
+    bool isNontemporal(const bh_view &view) const {
+        if (_nontemporal.find(view) != _nontemporal.end()) {
+            return true;
+        } else if (parent != NULL) {
+            return parent->isNontemporal(view);
+        } else {
+            return false;
+        }
+    }
+
     // Check if 'view' has been locally declared (e.g. a temporary variable)
     bool isBaseDeclared(const bh_base *base) const {
         if (util::exist_nconst(_declared_base, base)) {
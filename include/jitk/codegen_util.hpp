@@ -38,6 +38,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <jitk/base_db.hpp>
 #include <jitk/instruction.hpp>
 #include <jitk/fuser_cache.hpp>
+#include <jitk/plan_cache.hpp>
 #include <jitk/apply_fusion.hpp>
 
 
@@ -81,6 +82,7 @@ void write_kernel_function_arguments(const SymbolTable &symbols,
 // Writes a loop block, which corresponds to a parallel for-loop.
 // The two functions 'type_writer' and 'head_writer' should write the
 // backend specific data type names and for-loop headers respectively.
+// The optional 'tail_writer' is called right after the closing brace of each for-loop.
 void write_loop_block(const SymbolTable &symbols,
                       const Scope *parent_scope,
                       const LoopB &block,
@@ -95,7 +97,14 @@ void write_loop_block(const SymbolTable &symbols,
                                           bool loop_is_peeled,
                                           const std::vector<const LoopB *> &threaded_blocks,
                                           std::stringstream &out)> head_writer,
-                      std::stringstream &out);
+                      std::stringstream &out,
+                      std::function<void (const SymbolTable &symbols,
+                                          Scope &scope,
+                                          const LoopB &block,
+                                          const ConfigParser &config,
+                                          bool loop_is_peeled,
+                                          const std::vector<const LoopB *> &threaded_blocks,
+                                          std::stringstream &out)> tail_writer = nullptr);
 
 // Sets the constructor flag of each instruction in 'instr_list'
 // 'remotely_allocated_bases' is a collection of array bases already remotely allocated
@@ -120,10 +129,25 @@ void util_set_constructor_flag(std::vector<bh_instruction *> &instr_list, const
     }
 }
 
+// Removes BH_IDENTITY instructions from 'instr_list' that fill a whole new array with zeros and allocates
+// the arrays using zero initialized memory instead, which is free of charge since the anonymous mmap pages
+// are already zero. Arrays freed within 'instr_list' are left untouched since they might be contracted.
+// Returns the number of removed fills.
+int64_t util_elide_zero_fills(std::vector<bh_instruction *> &instr_list);
+
+// Removes and returns the instructions of 'instr_list' that an extension method accessing 'bases' depends on,
+// which are the instructions that access 'bases' and the earlier instructions they depend on in turn.
+// The remaining instructions in 'instr_list' are independent and may be executed after the extension method.
+std::vector<bh_instruction> util_extract_dependencies(std::vector<bh_instruction> &instr_list,
+                                                      const std::set<const bh_base *> &bases);
+
 // Handle the extension methods within the 'bhir'
+// When 'gemm_tile_bytes' is non-zero, a BLAS gemm followed by element-wise instructions on its output (an epilogue)
+// is executed in row tiles of about 'gemm_tile_bytes' of the output, each tile followed by its part of the epilogue.
 void util_handle_extmethod(component::ComponentImpl *self,
                            bh_ir *bhir,
-                           std::map<bh_opcode, extmethod::ExtmethodFace> &extmethods);
+                           std::map<bh_opcode, extmethod::ExtmethodFace> &extmethods,
+                           uint64_t gemm_tile_bytes = 0);
 
 // Handle the extension methods within the 'bhir'
 // This version takes a child component and possible an engine that must have a copyToHost() method
@@ -141,11 +165,12 @@ void util_handle_extmethod(component::ComponentImpl *self,
         auto childext = child_extmethods.find(instr.opcode);
 
         if (ext != extmethods.end() or childext != child_extmethods.end()) {
-            // Execute the instructions up until now
+            // Execute the instructions up until now that the extension method depends on
             bh_ir b;
-            b.instr_list = instr_list;
-            self->execute(&b);
-            instr_list.clear();
+            b.instr_list = util_extract_dependencies(instr_list, instr.get_bases_const());
+            if (not b.instr_list.empty()) {
+                self->execute(&b);
+            }
 
             if (ext != extmethods.end()) {
                 // Execute the extension method
@@ -189,10 +214,15 @@ inline std::vector<const LoopB*> find_threaded_blocks(const Block &block, Statis
  *     - void write_kernel(...)
  * 'EngineType' most be a engine implementation that exposes:
  *     - set_constructor_flag(...)
+ *     - FunctionType execute(...), which returns the launcher function of the executed kernel
+ *     - void launch(...)
+ *     - void freeBase(...)
+ * 'pcache' caches the execution plan of each instruction list, which makes it possible to skip the fusion,
+ * the symbol tables, and the code generation when executing the same instruction list again.
  */
-template<typename SelfType, typename EngineType>
+template<typename SelfType, typename EngineType, typename FunctionType>
 void handle_cpu_execution(SelfType &self, bh_ir *bhir, EngineType &engine, const ConfigParser &config, Statistics &stat,
-                          FuseCache &fcache) {
+                          FuseCache &fcache, PlanCache<FunctionType> &pcache) {
     using namespace std;
 
     const auto texecution = chrono::steady_clock::now();
@@ -201,6 +231,7 @@ void handle_cpu_execution(SelfType &self, bh_ir *bhir, EngineType &engine, const
     const bool index_as_var = config.defaultGet<bool>("index_as_var", true);
     const bool const_as_var = config.defaultGet<bool>("const_as_var", true);
     const bool monolithic = config.defaultGet<bool>("monolithic", false);
+    const bool use_plan_cache = config.defaultGet<bool>("plan_cache", false) and not monolithic;
 
     // Some statistics
     stat.record(bhir->instr_list);
@@ -214,10 +245,15 @@ void handle_cpu_execution(SelfType &self, bh_ir *bhir, EngineType &engine, const
 
         // Let's free device buffers and array memory
         for(bh_base *base: frees) {
-            bh_data_free(base);
+            engine.freeBase(base);
         }
     }
 
+    // Zero fills of new arrays are replaced by zero initialized memory
+    if (config.defaultGet<bool>("zero_fill_elision", false)) {
+        stat.zero_fill_elisions += util_elide_zero_fills(instr_list);
+    }
+
     // Set the constructor flag
     if (config.defaultGet<bool>("array_contraction", true)) {
         engine.set_constructor_flag(instr_list);
@@ -227,6 +263,40 @@ void handle_cpu_execution(SelfType &self, bh_ir *bhir, EngineType &engine, const
         }
     }
 
+    // Let's check the plan cache, which makes it possible to call the kernel launchers directly.
+    // NB: the origin ID of each instruction is its index in 'instr_list' (as assigned by get_block_list())
+    size_t plan_hash = 0;
+    if (use_plan_cache) {
+        for (size_t i = 0; i < instr_list.size(); ++i) {
+            instr_list[i]->origin_id = static_cast<int64_t>(i);
+        }
+        plan_hash = hash_plan(instr_list, const_as_var);
+        const vector<KernelPlan<FunctionType> > *plan = pcache.get(plan_hash);
+        if (plan != nullptr) {
+            for (const KernelPlan<FunctionType> &kernel: *plan) {
+                if (kernel.func != nullptr) {
+                    vector<bh_base*> params;
+                    params.reserve(kernel.params.size());
+                    for (const pair<int64_t, size_t> &p: kernel.params) {
+                        params.push_back(instr_list[p.first]->operand[p.second].base);
+                    }
+                    vector<uint64_t> offset_strides(kernel.offset_strides);
+                    vector<bh_constant_value> constants;
+                    constants.reserve(kernel.constants.size());
+                    for (int64_t origin_id: kernel.constants) {
+                        constants.push_back(instr_list[origin_id]->constant.value);
+                    }
+                    engine.launch(kernel.func, params, offset_strides, constants);
+                }
+                for (int64_t origin_id: kernel.frees) {
+                    engine.freeBase(instr_list[origin_id]->operand[0].base);
+                }
+            }
+            stat.time_total_execution += chrono::steady_clock::now() - texecution;
+            return;
+        }
+    }
+
     // Let's get the block list
     const vector<Block> block_list = get_block_list(instr_list, config, fcache, stat, false);
 
@@ -282,17 +352,47 @@ void handle_cpu_execution(SelfType &self, bh_ir *bhir, EngineType &engine, const
 
         // Finally, let's cleanup
         for(bh_base *base: symbols.getFrees()) {
-            bh_data_free(base);
+            engine.freeBase(base);
         }
     } else {
+        // The execution plan of 'instr_list', which we record while executing the blocks
+        vector<KernelPlan<FunctionType> > plan;
+
+        // Let's find the live range of the freed arrays. An array is released right after the last block
+        // that accesses it, which might be before the block of its BH_FREE. This way, the following blocks
+        // can reuse its memory. 'releases' maps a block index to the BH_FREE instructions to execute after it.
+        vector<vector<InstrPtr> > releases(block_list.size());
+        {
+            map<const bh_base*, size_t> last_access;
+            vector<pair<InstrPtr, size_t> > frees;
+            for (size_t i = 0; i < block_list.size(); ++i) {
+                for (const InstrPtr &instr: block_list[i].getAllInstr()) {
+                    if (instr->opcode == BH_FREE) {
+                        frees.push_back(make_pair(instr, i));
+                    } else if (not bh_opcode_is_system(instr->opcode)) {
+                        for (const bh_base *base: instr->get_bases_const()) {
+                            last_access[base] = i;
+                        }
+                    }
+                }
+            }
+            for (const pair<InstrPtr, size_t> &f: frees) {
+                auto it = last_access.find(f.first->operand[0].base);
+                releases[it == last_access.end() ? f.second : std::min(it->second, f.second)].push_back(f.first);
+            }
+        }
+
         // When creating a regular kernels (a block-nest per shared library), we create one kernel at a time
-        for(const Block &block: block_list) {
+        for(size_t block_idx = 0; block_idx < block_list.size(); ++block_idx) {
+            const Block &block = block_list[block_idx];
             assert(not block.isInstr());
 
             // Let's create the symbol table for the kernel
-            const SymbolTable symbols(block.getAllInstr(), block.getLoop().getAllNonTemps(), strides_as_var,
+            const vector<InstrPtr> block_instr_list = block.getAllInstr();
+            const SymbolTable symbols(block_instr_list, block.getLoop().getAllNonTemps(), strides_as_var,
                                       index_as_var, const_as_var);
             stat.record(symbols);
+            KernelPlan<FunctionType> kernel;
 
             // Let's execute the kernel
             if (not block.isSystemOnly()) { // We can skip this step if the kernel does no computation
@@ -309,13 +409,47 @@ void handle_cpu_execution(SelfType &self, bh_ir *bhir, EngineType &engine, const
                 }
 
                 // Let's execute the kernel
-                engine.execute(ss.str(), symbols.getParams(), symbols.offsetStrideViews(), constants);
+                kernel.func = engine.execute(ss.str(), symbols.getParams(), symbols.offsetStrideViews(), constants);
+
+                if (use_plan_cache) {
+                    for (const bh_base *base: symbols.getParams()) {
+                        bool found = false;
+                        for (const InstrPtr &instr: block_instr_list) {
+                            if (found) {
+                                break;
+                            }
+                            for (size_t i = 0; i < instr->operand.size() and not found; ++i) {
+                                if (not bh_is_constant(&instr->operand[i]) and instr->operand[i].base == base) {
+                                    kernel.params.push_back(make_pair(instr->origin_id, i));
+                                    found = true;
+                                }
+                            }
+                        }
+                        assert(found);
+                    }
+                    for (const bh_view *view: symbols.offsetStrideViews()) {
+                        kernel.offset_strides.push_back(static_cast<uint64_t>(view->start));
+                        for (int i = 0; i < view->ndim; ++i) {
+                            kernel.offset_strides.push_back(static_cast<uint64_t>(view->stride[i]));
+                        }
+                    }
+                    for (const bh_instruction *instr: constants) {
+                        kernel.constants.push_back(instr->origin_id);
+                    }
+                }
             }
 
-            // Finally, let's cleanup
-            for(bh_base *base: symbols.getFrees()) {
-                bh_data_free(base);
+            // Finally, let's release the arrays that are dead
+            for(const InstrPtr &instr: releases[block_idx]) {
+                engine.freeBase(instr->operand[0].base);
+                kernel.frees.push_back(instr->origin_id);
             }
+            if (use_plan_cache) {
+                plan.push_back(std::move(kernel));
+            }
+        }
+        if (use_plan_cache) {
+            pcache.insert(plan_hash, std::move(plan));
         }
     }
     stat.time_total_execution += chrono::steady_clock::now() - texecution;
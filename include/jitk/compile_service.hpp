@@ -0,0 +1,67 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __BH_JITK_COMPILE_SERVICE_HPP
+#define __BH_JITK_COMPILE_SERVICE_HPP
+
+#include <string>
+
+namespace bohrium {
+namespace jitk {
+
+/**
+ * Client of the local compile service `bh_compile_server`, which compiles kernels on behalf of all processes of a
+ * machine. The service deduplicates identical requests that are in flight, compiles on a bounded number of
+ * workers, and publishes the object file atomically at the requested path (typically in the shared cache dir).
+ */
+class CompileService {
+public:
+    // Path to the Unix domain socket of the service. The empty string disables the service.
+    std::string socket_path;
+    // Seconds to wait on the service before giving up and compiling locally
+    double timeout = 60;
+
+    explicit CompileService(std::string socket_path, double timeout = 60) : socket_path(std::move(socket_path)),
+                                                                            timeout(timeout) {}
+    CompileService() = default;
+
+    bool enabled() const {
+        return not socket_path.empty();
+    }
+
+    /**
+     *  Ask the service to compile 'source' using the command 'cmd_template' into 'object_abspath'.
+     *
+     *  Returns false when the service is unavailable, does not reply within `timeout`, or the compilation failed,
+     *  in which case the caller should compile the source itself. Safe to call from multiple threads.
+     */
+    bool compile(const std::string &cmd_template, const std::string &object_abspath,
+                 const std::string &source) const;
+};
+
+// The wire format of the service: a message is its length (uint64_t) followed by its bytes.
+// A request is the three messages: compile command, object path, and source. The reply is a single message,
+// which is empty on success and the error otherwise. Both functions throw runtime_error on I/O errors.
+void compile_service_write(int fd, const std::string &msg);
+std::string compile_service_read(int fd);
+
+}} // namespace bohrium::jitk
+
+#endif
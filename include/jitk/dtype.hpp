@@ -99,8 +99,10 @@ const char *write_cuda_type(bh_type dtype) {
     }
 }
 
-// Writes the union of C99 types that can make up a constant
-void write_c99_dtype_union(std::stringstream& out) {
+// Writes the union of C99 types that can make up a constant.
+// Without 'use_complex', the complex members are declared as arrays of two reals, which has the same size
+// and alignment but doesn't require <complex.h>
+void write_c99_dtype_union(std::stringstream& out, bool use_complex = true) {
     out << "\nunion dtype {\n";
     spaces(out, 4); out << write_c99_type(bh_type::BOOL)       << " " << bh_type_text(bh_type::BOOL)       << ";\n";
     spaces(out, 4); out << write_c99_type(bh_type::INT8)       << " " << bh_type_text(bh_type::INT8)       << ";\n";
@@ -113,8 +115,13 @@ void write_c99_dtype_union(std::stringstream& out) {
     spaces(out, 4); out << write_c99_type(bh_type::UINT64)     << " " << bh_type_text(bh_type::UINT64)     << ";\n";
     spaces(out, 4); out << write_c99_type(bh_type::FLOAT32)    << " " << bh_type_text(bh_type::FLOAT32)    << ";\n";
     spaces(out, 4); out << write_c99_type(bh_type::FLOAT64)    << " " << bh_type_text(bh_type::FLOAT64)    << ";\n";
-    spaces(out, 4); out << write_c99_type(bh_type::COMPLEX64)  << " " << bh_type_text(bh_type::COMPLEX64)  << ";\n";
-    spaces(out, 4); out << write_c99_type(bh_type::COMPLEX128) << " " << bh_type_text(bh_type::COMPLEX128) << ";\n";
+    if (use_complex) {
+        spaces(out, 4); out << write_c99_type(bh_type::COMPLEX64)  << " " << bh_type_text(bh_type::COMPLEX64)  << ";\n";
+        spaces(out, 4); out << write_c99_type(bh_type::COMPLEX128) << " " << bh_type_text(bh_type::COMPLEX128) << ";\n";
+    } else {
+        spaces(out, 4); out << write_c99_type(bh_type::FLOAT32) << " " << bh_type_text(bh_type::COMPLEX64)  << "[2];\n";
+        spaces(out, 4); out << write_c99_type(bh_type::FLOAT64) << " " << bh_type_text(bh_type::COMPLEX128) << "[2];\n";
+    }
     spaces(out, 4); out << write_c99_type(bh_type::R123)       << " " << bh_type_text(bh_type::R123)       << ";\n";
     out << "};\n";
 }
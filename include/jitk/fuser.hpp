@@ -37,6 +37,12 @@ std::vector<InstrPtr> simplify_instr_list(const std::vector<bh_instruction *> &i
 // are fused
 std::vector<Block> pre_fuser_lossy(const std::vector<bh_instruction *> &instr_list);
 
+// Creates a block list like pre_fuser_lossy() but reorders the instructions (without changing the semantic)
+// such that fully fusible instructions become adjacent. Each instruction that is ready to be scheduled is tested
+// for fusibility at most once per block, thus the cost is O(n * b) where 'b' is the number of blocks created while
+// it was ready, instead of a rescan of all ready instructions for every scheduled instruction.
+std::vector<Block> pre_fuser_reorder(const std::vector<bh_instruction *> &instr_list);
+
 // Creates a block list based on the 'instr_list' where each instruction gets its own nested block
 // NB: this function might reshape the instructions in 'instr_list'
 std::vector<Block> fuser_singleton(const std::vector<bh_instruction *> &instr_list);
@@ -57,6 +63,12 @@ void fuser_reshapable_first(std::vector<Block> &block_list, bool avoid_rank0_swe
 // 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
 void fuser_greedy(std::vector<Block> &block_list, bool avoid_rank0_sweep);
 
+// Fuses 'block_list' greedily like fuser_greedy() using graph::greedy_reachability()
+// 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
+// 'window' bounds the number of blocks fused together, which makes the fusion of huge block lists linear
+// (zero means unbounded)
+void fuser_greedy_reachability(std::vector<Block> &block_list, bool avoid_rank0_sweep, uint64_t window);
+
 } // jit
 } // bohrium
 
@@ -32,6 +32,10 @@ If not, see <http://www.gnu.org/licenses/>.
 namespace bohrium {
 namespace jitk {
 
+// Hash of the structure of an instruction list, which is the lookup key of the fuse cache.
+// NB: the hash ignores the base arrays and the constants of the instructions
+size_t hash_instr_list(const std::vector<bh_instruction *> &instr_list);
+
 class FuseCache {
 private:
     std::map<size_t, std::vector<Block> > _cache;
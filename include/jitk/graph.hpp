@@ -139,6 +139,13 @@ std::vector<Block> topological(DAG &dag, bool avoid_rank0_sweep) {
 // 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
 void greedy(DAG &dag, bool avoid_rank0_sweep);
 
+// Merges the blocks in 'block_list' greedily like greedy() but maintains the reachability between the blocks
+// incrementally using bitsets, which makes the legality check of a merge O(V/64) instead of a graph traversal.
+// 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
+//
+// Complexity: O(V * V * V/64) worst case and O(V * V/64) memory
+void greedy_reachability(std::vector<Block> &block_list, bool avoid_rank0_sweep);
+
 } // graph
 } // jit
 } // bohrium
@@ -32,8 +32,15 @@ namespace bohrium {
 namespace jitk {
 
 
-// Write the source code of an instruction (set 'opencl' for OpenCL specific output)
-void write_instr(const Scope &scope, const bh_instruction &instr, std::stringstream &out, bool opencl = false);
+// Write the source code of an instruction (set 'opencl' for OpenCL specific output).
+// Set 'nontemporal' to write the output array element using the non-temporal store macro
+// `BH_STREAM_STORE<nbytes>(ptr, value)`, which the kernel must define.
+void write_instr(const Scope &scope, const bh_instruction &instr, std::stringstream &out, bool opencl = false,
+                 bool nontemporal = false);
+
+// Write a software prefetch of the array element that a GATHER or SCATTER will access `scope.prefetch_distance`
+// iterations ahead of the innermost loop. Writes nothing when prefetching is disabled or not applicable.
+void write_prefetch(const Scope &scope, const bh_instruction &instr, std::stringstream &out);
 
 // Return true when 'opcode' has a neutral initial reduction value
 bool has_reduce_identity(bh_opcode opcode);
@@ -0,0 +1,108 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __BH_JITK_PLAN_CACHE_HPP
+#define __BH_JITK_PLAN_CACHE_HPP
+
+#include <list>
+#include <map>
+#include <vector>
+#include <utility>
+
+#include <bh_instruction.hpp>
+#include <jitk/statistics.hpp>
+
+
+namespace bohrium {
+namespace jitk {
+
+// Hash of an instruction list that identifies its execution plan. On top of the structure hashed by the
+// fuse cache, it includes the pattern of base arrays, their types and sizes, the constructor flags, and
+// the constants that are hard-coded into the kernel source (e.g. when not using `const_as_var`).
+size_t hash_plan(const std::vector<bh_instruction *> &instr_list, bool const_as_var);
+
+// The execution plan of a kernel, which is everything needed to call its launcher without code generation.
+// The base arrays and constants are referenced by the origin ID of the instruction (the index in the
+// instruction list) and the operand index, thus a plan can be reused by any instruction list of the same hash.
+template<typename FunctionType>
+struct KernelPlan {
+    // The launcher function or NULL when the kernel does no computation
+    FunctionType func = nullptr;
+    // The (origin ID, operand index) of each kernel parameter, in the order of `SymbolTable::getParams()`
+    std::vector<std::pair<int64_t, size_t> > params;
+    // The offset-and-strides argument, which is part of the plan hash
+    std::vector<uint64_t> offset_strides;
+    // The origin ID of the instructions of each constant argument
+    std::vector<int64_t> constants;
+    // The origin ID of the BH_FREE instructions to execute after the kernel
+    std::vector<int64_t> frees;
+};
+
+// The plans of the most recently used instruction lists. Since the plan hash includes the offsets and shapes of the
+// views, a program that slices differently every flush would otherwise grow the cache without limit.
+template<typename FunctionType>
+class PlanCache {
+private:
+    typedef std::vector<KernelPlan<FunctionType> > Plan;
+    // The plan hashes ordered from the most to the least recently used
+    std::list<size_t> _lru;
+    std::map<size_t, std::pair<Plan, std::list<size_t>::iterator> > _cache;
+    // The maximum number of plans to keep (zero means unlimited)
+    const uint64_t _max_size;
+public:
+    // Some statistics
+    jitk::Statistics &stat;
+
+    // The constructor takes the statistic object and the maximum number of plans to keep
+    PlanCache(jitk::Statistics &stat, uint64_t max_size = 0) : _max_size(max_size), stat(stat) {}
+
+    // Returns the plan of 'plan_hash' or NULL when not found
+    const Plan *get(size_t plan_hash) {
+        ++stat.plan_cache_lookups;
+        auto it = _cache.find(plan_hash);
+        if (it == _cache.end()) {
+            ++stat.plan_cache_misses;
+            return nullptr;
+        }
+        _lru.splice(_lru.begin(), _lru, it->second.second);
+        return &it->second.first;
+    }
+
+    // Insert the plan of 'plan_hash' and evict the least recently used plan when the cache is full
+    void insert(size_t plan_hash, Plan plan) {
+        auto it = _cache.find(plan_hash);
+        if (it != _cache.end()) {
+            it->second.first = std::move(plan);
+            _lru.splice(_lru.begin(), _lru, it->second.second);
+            return;
+        }
+        if (_max_size > 0 and _cache.size() >= _max_size) {
+            _cache.erase(_lru.back());
+            _lru.pop_back();
+        }
+        _lru.push_front(plan_hash);
+        _cache.insert(std::make_pair(plan_hash, std::make_pair(std::move(plan), _lru.begin())));
+    }
+};
+
+} // jit
+} // bohrium
+
+#endif
@@ -27,6 +27,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <sstream>
 #include <fstream>
 #include <vector>
+#include <map>
 
 #include <colors.hpp>
 #include <bh_instruction.hpp>
@@ -56,8 +57,16 @@ class Statistics {
     uint64_t threading_below_threshold = 0;
     uint64_t kernel_cache_lookups      = 0;
     uint64_t kernel_cache_misses       = 0;
+    uint64_t kernel_tier_ups           = 0;
     uint64_t fuser_cache_lookups       = 0;
     uint64_t fuser_cache_misses        = 0;
+    uint64_t plan_cache_lookups        = 0;
+    uint64_t plan_cache_misses         = 0;
+    uint64_t memory_allocations        = 0;
+    uint64_t memory_pool_hits          = 0;
+    uint64_t zero_fill_elisions        = 0;
+    uint64_t worker_pool_launches      = 0;
+    std::map<int, uint64_t> numa_node_bytes; // The memory allocated on each NUMA node
     uint64_t num_instrs_into_fuser     = 0;
     uint64_t num_blocks_out_of_fuser   = 0;
     std::chrono::duration<double> time_total_execution{0};
@@ -93,6 +102,11 @@ class Statistics {
             out << BLU << "[" << backend_name << "] Profiling: \n" << RST;
             out << "Fuse cache hits:                 " << GRN << fuse_cache_hits()                   << "\n" << RST;
             out << "Kernel cache hits                " << GRN << kernel_cache_hits()                 << "\n" << RST;
+            out << "Kernel recompilations:           " << GRN << kernel_tier_ups                     << "\n" << RST;
+            out << "Plan cache hits:                 " << GRN << plan_cache_hits()                   << "\n" << RST;
+            out << "Memory pool hits:                " << GRN << memory_pool_hits_ratio()            << "\n" << RST;
+            out << "Zero fill elisions:              " << GRN << zero_fill_elisions                  << "\n" << RST;
+            out << "Worker pool launches:            " << GRN << worker_pool_launches                << "\n" << RST;
             out << "Array contractions:              " << GRN << array_contractions()                << "\n" << RST;
             out << "Outer-fusion ratio:              " << GRN << outer_fusion_ratio()                << "\n" << RST;
             out << "\n";
@@ -101,6 +115,10 @@ class Statistics {
             out << "Total Work:                      " << GRN << totalwork << " operations"          << "\n" << RST;
             out << "Throughput:                      " << GRN << throughput() << "ops"               << "\n" << RST;
             out << "Work below par-threshold (1000): " << GRN << work_below_thredshold() << "%"      << "\n" << RST;
+            for (const auto &node: numa_node_bytes) {
+                out << "Memory on NUMA node " << node.first << ":           " << GRN << node.second / 1024.0 / 1024.0
+                    << " MB" << "\n" << RST;
+            }
             out << "\n";
             out << "Wall clock:                      " << BLU << wallclock.count() << "s"            << "\n" << RST;
             out << "Total Execution:                 " << BLU << time_total_execution.count() << "s" << "\n" << RST;
@@ -135,6 +153,11 @@ class Statistics {
             file << backend_name << ":"                                         << "\n";
             file << "  fuse_cache_hits: "       << fuse_cache_hits()            << "\n";
             file << "  kernel_cache_hits: "     << kernel_cache_hits()          << "\n";
+            file << "  kernel_recompilations: " << kernel_tier_ups              << "\n";
+            file << "  plan_cache_hits: "       << plan_cache_hits()            << "\n";
+            file << "  memory_pool_hits: "      << memory_pool_hits_ratio()     << "\n";
+            file << "  zero_fill_elisions: "    << zero_fill_elisions           << "\n";
+            file << "  worker_pool_launches: "  << worker_pool_launches         << "\n";
             file << "  array_contractions: "    << array_contractions()         << "\n";
             file << "  outer_fusion_ratio: "    << outer_fusion_ratio()         << "\n";
             file << "  memory_usage: "          << memory_usage()               << "\n"; // mb
@@ -142,6 +165,12 @@ class Statistics {
             file << "  total_work: "            << totalwork                    << "\n"; // ops
             file << "  throughput: "            << throughput()                 << "\n"; // ops
             file << "  work_below_thredshold: " << work_below_thredshold()      << "\n"; // %
+            if (not numa_node_bytes.empty()) {
+                file << "  numa_node_memory:"                                   << "\n";
+                for (const auto &node: numa_node_bytes) {
+                    file << "    node" << node.first << ": " << node.second / 1024.0 / 1024.0 << "\n"; // mb
+                }
+            }
             file << "  timing:"                                                 << "\n";
             file << "    wall_clock: "          << wallclock.count()            << "\n"; // s
             file << "    total_execution: "     << time_total_execution.count() << "\n"; // s
@@ -190,6 +219,14 @@ class Statistics {
         return pprint_ratio(kernel_cache_lookups - kernel_cache_misses, kernel_cache_lookups);
     }
 
+    std::string plan_cache_hits() {
+        return pprint_ratio(plan_cache_lookups - plan_cache_misses, plan_cache_lookups);
+    }
+
+    std::string memory_pool_hits_ratio() {
+        return pprint_ratio(memory_pool_hits, memory_allocations);
+    }
+
     std::string array_contractions() {
         return pprint_ratio(num_temp_arrays, num_base_arrays);
     }
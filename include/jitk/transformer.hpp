@@ -34,6 +34,10 @@ namespace jitk {
 // Transpose blocks such that reductions gets as innermost as possible
 void push_reductions_inwards(std::vector<Block> &block_list);
 
+// Interchanges the loops of each non-sweeped block within 'block_list' such that the axis with the smallest
+// strides becomes the innermost loop
+void interchange_for_locality(std::vector<Block> &block_list);
+
 // Splits the 'block_list' in order to achieve a minimum amount of threading (if possible)
 void split_for_threading(std::vector<Block> &block_list, uint64_t min_threading=1000, uint64_t cur_threading=0);
 
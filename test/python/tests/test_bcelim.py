@@ -0,0 +1,85 @@
+import util
+import bohrium as bh
+import bohrium.blas
+
+
+def has_blas():
+    try:
+        a = bh.arange(4).astype(bh.float64).reshape(2, 2)
+        bh.blas.gemm(a, a)
+        return True
+    except Exception as e:
+        print("\n\033[31m[ext] Cannot test the elimination of BLAS extension methods.\033[0m")
+        print(e)
+        return False
+
+
+class test_bcelim_common:
+    def init(self):
+        for t in util.TYPES.NORMAL:
+            cmd = "a = M.arange(%d, dtype=%s); " % (100, t)
+            yield cmd
+
+    def test_repeated(self, cmd):
+        cmd += "res = (a * 2) + (a * 2)"
+        return cmd
+
+    def test_overwritten_input(self, cmd):
+        cmd += "res = a * 2; a += 1; res = res + a * 2"
+        return cmd
+
+    def test_overwritten_input_view(self, cmd):
+        cmd += "b = a * 3; a[10:20] = 7; c = a * 3; res = b + c; del b, c"
+        return cmd
+
+    def test_overwritten_output(self, cmd):
+        cmd += "b = a + 1; b += 5; c = a + 1; res = b - c; del b, c"
+        return cmd
+
+
+class test_bcelim_dead:
+    def init(self):
+        for t in util.TYPES.NORMAL:
+            cmd = "a = M.arange(%d, dtype=%s); " % (100, t)
+            yield cmd
+
+    def test_freed_unread(self, cmd):
+        cmd += "t = a * 3; del t; res = a + 1"
+        return cmd
+
+    def test_overwritten_unread(self, cmd):
+        cmd += "t = a * 3; t[:] = a; res = t + 1; del t"
+        return cmd
+
+    def test_partially_read(self, cmd):
+        cmd += "t = a * 3; t[::2] = 0; res = a + t; del t"
+        return cmd
+
+    def test_synced(self, cmd):
+        cmd += "res = M.zeros_like(a); res += a; res *= 2"
+        return cmd
+
+    def test_synced_then_freed(self, cmd):
+        cmd_np = cmd + "t = a * 3; res = np.array(t[5:15]); del t"
+        cmd_bh = cmd + "t = a * 3; res = t[5:15].copy2numpy(); del t"
+        return cmd_np, cmd_bh
+
+
+class test_bcelim_extmethod:
+    def init(self):
+        if not has_blas():
+            return
+
+        for t in util.TYPES.FLOAT:
+            cmd  = "a = M.arange(%d, dtype=%s).reshape(%s); " % (100, t, (10, 10))
+            yield cmd
+
+    def test_temporary_operands(self, cmd):
+        cmd_np = cmd + "x = a * 2; y = a + 1; res = np.dot(x, y); del x, y"
+        cmd_bh = cmd + "x = a * 2; y = a + 1; res = bh.blas.gemm(x, y); del x, y"
+        return cmd_np, cmd_bh
+
+    def test_unread_output(self, cmd):
+        cmd_np = cmd + "x = a * 2; res = x + 1; del x"
+        cmd_bh = cmd + "x = a * 2; y = bh.blas.gemm(x, a); res = x + 1; del x, y"
+        return cmd_np, cmd_bh
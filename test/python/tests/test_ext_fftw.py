@@ -0,0 +1,66 @@
+import util
+import bohrium as bh
+import bohrium.fftw
+
+def has_ext():
+    try:
+        a = bh.arange(4).astype(bh.float64)
+        bh.fftw.rfftn(a)
+        return True
+    except Exception as e:
+        print("\n\033[31m[ext] Cannot test FFTW extension methods.\033[0m")
+        print(e)
+        return False
+
+
+class test_ext_fftw:
+    def init(self):
+        if not has_ext():
+            return
+
+        for t in util.TYPES.FLOAT:
+            for shape in ((16,), (15,), (8, 12), (5, 6, 7)):
+                # The values are in [1, 2[ thus the float32 round-trip is within the relative tolerance
+                cmd  = "np.random.seed(123456); "
+                cmd += "a = M.array(1 + np.random.rand(*%s), dtype=%s); " % (shape, t)
+                yield cmd, t
+
+    # NB: NumPy transforms float32 in double precision thus we compare single precision through round-trips
+    def test_r2c(self, args):
+        cmd, t = args
+        if t == "np.float32":
+            return "res = 0"
+        cmd_np = cmd + "res = np.fft.rfftn(a); "
+        cmd_bh = cmd + "res = bh.fftw.rfftn(a); "
+        return cmd_np, cmd_bh
+
+    def test_c2r(self, args):
+        cmd, t = args
+        if t == "np.float32":
+            return "res = 0"
+        cmd += "c = M.array(np.fft.rfftn(a.copy2numpy() if BH else a)); "
+        cmd_np = cmd + "res = np.fft.irfftn(c, a.shape); "
+        cmd_bh = cmd + "res = bh.fftw.irfftn(c, a.shape[-1]); "
+        return cmd_np, cmd_bh
+
+    def test_roundtrip(self, args):
+        cmd, _ = args
+        cmd_np = cmd + "res = a; "
+        cmd_bh = cmd + "res = bh.fftw.irfftn(bh.fftw.rfftn(a), a.shape[-1]); "
+        return cmd_np, cmd_bh
+
+    def test_roundtrip_dtype(self, args):
+        cmd, t = args
+        complex_type = "np.complex64" if t == "np.float32" else "np.complex128"
+        cmd_np = cmd + "res = np.array([a.dtype == %s, True], dtype=np.int32); " % t
+        cmd_bh = cmd + "c = bh.fftw.rfftn(a); "
+        cmd_bh += "res = np.array([bh.fftw.irfftn(c, a.shape[-1]).dtype == %s, c.dtype == %s], dtype=np.int32); " \
+                  % (t, complex_type)
+        return cmd_np, cmd_bh
+
+    def test_roundtrip_strided(self, args):
+        cmd, _ = args
+        cmd += "b = M.concatenate((a, a), axis=-1)[..., ::2]; "
+        cmd_np = cmd + "res = b; "
+        cmd_bh = cmd + "res = bh.fftw.irfftn(bh.fftw.rfftn(b), b.shape[-1]); "
+        return cmd_np, cmd_bh
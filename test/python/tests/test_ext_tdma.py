@@ -19,26 +19,86 @@ class test_ext_tdma:
             return
 
         for t in util.TYPES.FLOAT:
-            for r in (2, 10, 100):
-                cmd  = "np.random.seed(123456); "
-                # matrix has to be diagonally dominant for Thomas algorithm to be stable
-                cmd += "a = 1 - 2 * M.array(np.random.rand(*%s), dtype=%s); " % ((2, r), t)
-                cmd += "b = 100 * M.array(np.random.rand(*%s), dtype=%s); " % ((2, r), t)
-                cmd += "c = 1 - 2 * M.array(np.random.rand(*%s), dtype=%s); " % ((2, r), t)
-                cmd += "d = M.array(np.random.rand(*%s), dtype=%s); " % ((2, r), t)
-                cmd += "matrix = M.empty(%s, dtype=%s); " % ((2, r, r), t)
-                cmd += "matrix[0] = M.diag(a[0,1:], k=-1) + M.diag(b[0]) + M.diag(c[0,:-1], k=1); "
-                cmd += "matrix[1] = M.diag(a[1,1:], k=-1) + M.diag(b[1]) + M.diag(c[1,:-1], k=1); "
-                yield cmd, t
+            # The systems are solved in groups of SIMD width (4 float64 or 8 float32), thus we test
+            # both full groups and remaining systems
+            for m in (2, 5, 8, 13):
+                for r in (2, 10, 100):
+                    cmd  = "np.random.seed(123456); "
+                    # matrix has to be diagonally dominant for Thomas algorithm to be stable
+                    cmd += "a = 1 - 2 * M.array(np.random.rand(*%s), dtype=%s); " % ((m, r), t)
+                    cmd += "b = 100 * M.array(np.random.rand(*%s), dtype=%s); " % ((m, r), t)
+                    cmd += "c = 1 - 2 * M.array(np.random.rand(*%s), dtype=%s); " % ((m, r), t)
+                    cmd += "d = M.array(np.random.rand(*%s), dtype=%s); " % ((m, r), t)
+                    cmd += "matrix = np.array([np.diag(a[i,1:], k=-1) + np.diag(b[i]) + np.diag(c[i,:-1], k=1) " \
+                           "for i in range(%d)]) if not BH else None; " % m
+                    yield cmd, t, m, r
 
     def test_1d(self, args):
-        cmd, _ = args
+        cmd, _, _, _ = args
         cmd_np = cmd + "res = np.linalg.solve(matrix[0], d[0]); "
         cmd_bh = cmd + "res = bh.linalg.solve_tridiagonal(a[0], b[0], c[0], d[0]); "
         return cmd_np, cmd_bh
 
     def test_multidim(self, args):
-        cmd, _ = args
+        cmd, _, _, _ = args
         cmd_np = cmd + "res = np.array([np.linalg.solve(mm, dd) for mm,dd in zip(matrix,d)]); "
         cmd_bh = cmd + "res = bh.linalg.solve_tridiagonal(a, b, c, d); "
         return cmd_np, cmd_bh
+
+    def test_interleaved(self, args):
+        cmd, _, _, _ = args
+        # The element 'i' of all systems are consecutive in memory
+        cmd_np = cmd + "res = np.array([np.linalg.solve(mm, dd) for mm,dd in zip(matrix,d)]); "
+        cmd_bh = cmd + "ai, bi, ci, di = [M.array(x.T).T for x in (a, b, c, d)]; "
+        cmd_bh += "res = bh.linalg.solve_tridiagonal(ai, bi, ci, di); "
+        return cmd_np, cmd_bh
+
+    def test_strided(self, args):
+        cmd, t, m, r = args
+        # Every other system and every other element of each system
+        cmd_np = cmd + "res = np.array([np.linalg.solve(mm, dd) for mm,dd in zip(matrix,d)]); "
+        cmd_bh = cmd
+        for x in ("a", "b", "c", "d"):
+            cmd_bh += "w = M.zeros(%s, dtype=%s); w[::2, ::2] = %s; %s2 = w[::2, ::2]; " % ((2 * m, 2 * r), t, x, x)
+        cmd_bh += "res = bh.linalg.solve_tridiagonal(a2, b2, c2, d2); "
+        return cmd_np, cmd_bh
+
+
+# solve_tridiagonal() copies its input into contiguous arrays, thus we call the extension method directly on
+# interleaved and strided views, which are the layouts the kernels specialize on
+class test_ext_tdma_layout:
+    def init(self):
+        if not has_ext():
+            return
+
+        for t in util.TYPES.FLOAT:
+            for m in (5, 8, 13):
+                for r in (2, 10):
+                    cmd  = "np.random.seed(123456); "
+                    cmd += "a = 1 - 2 * M.array(np.random.rand(*%s), dtype=%s); " % ((m, r), t)
+                    cmd += "b = 100 * M.array(np.random.rand(*%s), dtype=%s); " % ((m, r), t)
+                    cmd += "c = 1 - 2 * M.array(np.random.rand(*%s), dtype=%s); " % ((m, r), t)
+                    cmd += "d = M.array(np.random.rand(*%s), dtype=%s); " % ((m, r), t)
+                    cmd += "res = np.array([np.linalg.solve(np.diag(a[i,1:], k=-1) + np.diag(b[i]) + " \
+                           "np.diag(c[i,:-1], k=1), d[i]) for i in range(%d)]) if not BH else None; " % m
+                    yield cmd, t, m, r
+
+    def test_interleaved(self, args):
+        cmd, t, m, r = args
+        # The element 'i' of all systems are consecutive in all operands
+        cmd_bh = cmd + "diag = M.empty(%s, dtype=%s).transpose((0, 2, 1)); " % ((3, r, m), t)
+        cmd_bh += "diag[0] = a; diag[1] = b; diag[2] = c; "
+        cmd_bh += "di = M.array(d.T).T; "
+        cmd_bh += "res = M.zeros(%s, dtype=%s).T; " % ((r, m), t)
+        cmd_bh += "bh.ufuncs.extmethod('tdma', res, diag, di); "
+        return cmd, cmd_bh
+
+    def test_strided(self, args):
+        cmd, t, m, r = args
+        # Every other system and every other element of each system in all operands
+        cmd_bh = cmd + "diag = M.zeros(%s, dtype=%s)[:, ::2, ::2]; " % ((3, 2 * m, 2 * r), t)
+        cmd_bh += "diag[0] = a; diag[1] = b; diag[2] = c; "
+        cmd_bh += "d2 = M.zeros(%s, dtype=%s)[::2, ::2]; d2[...] = d; " % ((2 * m, 2 * r), t)
+        cmd_bh += "res = M.zeros(%s, dtype=%s)[::2, ::2]; " % ((2 * m, 2 * r), t)
+        cmd_bh += "bh.ufuncs.extmethod('tdma', res, diag, d2); "
+        return cmd, cmd_bh
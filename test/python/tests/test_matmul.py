@@ -0,0 +1,121 @@
+import util
+import bohrium as bh
+import bohrium.blas
+
+
+def has_ext():
+    try:
+        a = bh.arange(4).astype(bh.float64).reshape(2, 2)
+        bh.blas.gemm(a, a)
+        return True
+    except Exception as e:
+        print("\n\033[31m[ext] Cannot test the rewrite of matrix products into BLAS.\033[0m")
+        print(e)
+        return False
+
+
+# The BCCON filter rewrites broadcasted multiply-and-sum products into BLAS gemm when the
+# product has at least 2^15 multiply-adds, thus the shapes are above that threshold
+class test_matmul:
+    def init(self):
+        if not has_ext():
+            return
+
+        for t in util.TYPES.FLOAT + util.TYPES.COMPLEX:
+            for (m, k, n) in ((40, 50, 30), (65, 512, 1), (1, 512, 65)):
+                cmd  = "a = M.arange(%d, dtype=%s).reshape(%s) / %d; " % (m * k, t, (m, k), m * k)
+                cmd += "b = M.arange(%d, dtype=%s).reshape(%s) / %d; " % (k * n, t, (k, n), k * n)
+                yield cmd
+
+    def test_sum_broadcast(self, cmd):
+        cmd += "res = M.sum(a[:, :, None] * b[None, :, :], 1)"
+        return cmd
+
+    def test_add_reduce(self, cmd):
+        cmd += "res = M.add.reduce(a[:, None] * b.T, -1)"
+        return cmd
+
+    def test_no_blas(self, cmd):
+        cmd_np = cmd + "res = np.dot(a, b)"
+        cmd_bh = cmd + "res = bh.linalg.matmul(a, b, no_blas=True)"
+        return cmd_np, cmd_bh
+
+    def test_transposed(self, cmd):
+        cmd += "at = M.array(a.T).T; bt = M.array(b.T).T; "
+        cmd += "res = M.sum(at[:, :, None] * bt[None, :, :], 1)"
+        return cmd
+
+    def test_transposed_output(self, cmd):
+        cmd += "res = M.sum(b.T[:, :, None] * a.T[None, :, :], 1)"
+        return cmd
+
+    def test_strided(self, cmd):
+        cmd += "a2 = M.concatenate((a, a), axis=1)[:, ::2]; "
+        cmd += "b2 = M.concatenate((b, b), axis=1)[:, ::2]; "
+        cmd += "res = M.add.reduce(a2[:, None] * b2.T, -1)"
+        return cmd
+
+
+class test_matvec:
+    def init(self):
+        if not has_ext():
+            return
+
+        for t in util.TYPES.FLOAT + util.TYPES.COMPLEX:
+            for (m, k) in ((200, 200), (129, 300)):
+                cmd  = "a = M.arange(%d, dtype=%s).reshape(%s) / %d; " % (m * k, t, (m, k), m * k)
+                cmd += "x = M.arange(%d, dtype=%s) / %d; " % (k, t, k)
+                cmd += "y = M.arange(%d, dtype=%s) / %d; " % (m, t, m)
+                yield cmd
+
+    def test_matvec(self, cmd):
+        cmd += "res = M.add.reduce(a * x, -1)"
+        return cmd
+
+    def test_vecmat(self, cmd):
+        cmd += "res = M.add.reduce(y[:, None] * a, 0)"
+        return cmd
+
+    def test_matvec_transposed(self, cmd):
+        cmd += "at = M.array(a.T); "
+        cmd += "res = M.add.reduce(at.T * x, -1)"
+        return cmd
+
+    def test_matvec_strided(self, cmd):
+        cmd += "x2 = M.concatenate((x, x))[::2]; "
+        cmd += "res = M.add.reduce(a * x2, -1)"
+        return cmd
+
+
+# The OpenMP engine may execute a gemm and the element-wise instructions that consume it in row tiles
+# (see 'gemm_tile' in the config), which the CI exercises with a small tile size
+class test_gemm_epilogue:
+    def init(self):
+        if not has_ext():
+            return
+
+        for t in util.TYPES.FLOAT:
+            for (m, k, n) in ((200, 40, 64), (257, 33, 17)):
+                cmd  = "a = M.arange(%d, dtype=%s).reshape(%s) / %d; " % (m * k, t, (m, k), m * k)
+                cmd += "b = M.arange(%d, dtype=%s).reshape(%s) / %d; " % (k * n, t, (k, n), k * n)
+                cmd += "bias = M.arange(%d, dtype=%s) / %d; " % (n, t, n)
+                yield cmd, m, n
+
+    def test_bias_broadcast(self, args):
+        cmd, _, _ = args
+        cmd_np = cmd + "res = np.dot(a, b) + bias[None, :]"
+        cmd_bh = cmd + "res = bh.blas.gemm(a, b) + bias[None, :]"
+        return cmd_np, cmd_bh
+
+    def test_freed_temporary(self, args):
+        cmd, _, _ = args
+        cmd_np = cmd + "c = np.dot(a, b); t = c * 2; res = t + bias; del c, t"
+        cmd_bh = cmd + "c = bh.blas.gemm(a, b); t = c * 2; res = t + bias; del c, t"
+        return cmd_np, cmd_bh
+
+    def test_transposed_output(self, args):
+        cmd, m, n = args
+        cmd += "res = M.zeros(%s, dtype=a.dtype); " % ((n, m),)
+        cmd_np = cmd + "res.T[...] = np.dot(a, b) * 2 + bias"
+        cmd_bh = cmd + "res.T[...] = bh.blas.gemm(a, b) * 2 + bias"
+        return cmd_np, cmd_bh
@@ -0,0 +1,36 @@
+import util
+
+
+# Stencils along the innermost axis, which the OpenMP engine may load through rotating registers
+# (see 'rotating_registers' in the config)
+class test_stencil:
+    def init(self):
+        for t in util.TYPES.FLOAT:
+            for shape in ((3, 40), (17, 33), (4, 5, 23)):
+                cmd = "a = M.arange(%d, dtype=%s).reshape(%s) / 100; " % (util.prod(shape), t, shape)
+                yield cmd
+
+    def test_3point(self, cmd):
+        cmd += "res = a[..., :-2] + a[..., 1:-1] * 2 + a[..., 2:]"
+        return cmd
+
+    def test_5point(self, cmd):
+        cmd += "res = a[..., 1:-1, :-2] + a[..., 1:-1, 2:] + a[..., :-2, 1:-1] + a[..., 2:, 1:-1] " \
+               "- 4 * a[..., 1:-1, 1:-1]"
+        return cmd
+
+    def test_gap(self, cmd):
+        cmd += "res = a[..., :-4] - a[..., 4:] + a[..., 2:-2]"
+        return cmd
+
+    def test_strided(self, cmd):
+        cmd += "res = a[..., :-2:2] * a[..., 2::2]"
+        return cmd
+
+    def test_inplace(self, cmd):
+        cmd += "res = a.copy(); res[..., 1:-1] = res[..., :-2] + res[..., 2:]"
+        return cmd
+
+    def test_reused(self, cmd):
+        cmd += "res = M.zeros_like(a); res[..., 1:-1] = a[..., :-2] * a[..., 1:-1]; res[..., 1:-1] += a[..., 2:]"
+        return cmd
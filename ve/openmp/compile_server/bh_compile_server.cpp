@@ -0,0 +1,214 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A local compile service, which compiles the kernels of all Bohrium processes on the machine that set the
+// `compile_server` option to the socket of the service. Identical requests in flight are compiled once and
+// at most `jobs` compilations run at a time. The object files are published atomically at the requested path.
+// Only the owner can connect and only the compile commands of the [openmp] section of the server's own config
+// (`compiler_cmd` and `compiler_cmd_fast`) are executed.
+// Usage: bh_compile_server <socket path> [jobs]
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <set>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <boost/filesystem.hpp>
+
+#include <bh_config_parser.hpp>
+#include <jitk/compiler.hpp>
+#include <jitk/compile_service.hpp>
+
+using namespace std;
+using namespace bohrium;
+namespace fs = boost::filesystem;
+
+namespace {
+
+class Service {
+    // The compile commands that clients may request
+    const set<string> _allowed_cmds;
+    mutex _mutex;
+    condition_variable _job_done;
+    // Number of compilations that may start
+    int _free_jobs;
+    // The compilations in flight by object path. The result is the error message or the empty string on success
+    map<string, shared_future<string> > _in_flight;
+
+    // Compile 'source' into 'object' when a job is available
+    string build(const string &cmd_template, const string &object, const string &source) {
+        {
+            unique_lock<mutex> lock(_mutex);
+            _job_done.wait(lock, [this]() { return _free_jobs > 0; });
+            --_free_jobs;
+        }
+        string ret;
+        const fs::path tmp = fs::unique_path(object + ".%%%%-%%%%");
+        try {
+            jitk::Compiler(cmd_template, false).compile(tmp.string(), source.c_str(), source.size());
+            fs::rename(tmp, object);
+        } catch (const exception &e) {
+            ret = e.what();
+            boost::system::error_code ec;
+            fs::remove(tmp, ec);
+        }
+        {
+            lock_guard<mutex> lock(_mutex);
+            ++_free_jobs;
+        }
+        _job_done.notify_one();
+        return ret;
+    }
+
+public:
+    Service(int jobs, set<string> allowed_cmds) : _allowed_cmds(std::move(allowed_cmds)), _free_jobs(jobs) {}
+
+    // Returns the empty string when 'object' has been published and the error message otherwise
+    string compile(const string &cmd_template, const string &object, const string &source) {
+        if (_allowed_cmds.find(cmd_template) == _allowed_cmds.end()) {
+            return "the compile command does not match the configured compile commands of the server";
+        }
+        promise<string> result;
+        shared_future<string> in_flight;
+        {
+            lock_guard<mutex> lock(_mutex);
+            auto it = _in_flight.find(object);
+            if (it != _in_flight.end()) {
+                in_flight = it->second;
+            } else if (fs::exists(object)) {
+                return "";
+            } else {
+                _in_flight[object] = result.get_future().share();
+            }
+        }
+        // An identical request is in flight, we wait for its result
+        if (in_flight.valid()) {
+            return in_flight.get();
+        }
+        // Otherwise, we compile and the identical requests wait for our result
+        const string ret = build(cmd_template, object, source);
+        {
+            lock_guard<mutex> lock(_mutex);
+            result.set_value(ret);
+            _in_flight.erase(object);
+        }
+        return ret;
+    }
+};
+
+// Serve the request of the connection 'fd'
+void serve(Service &service, int fd) {
+    try {
+        const string cmd_template = jitk::compile_service_read(fd);
+        const string object = jitk::compile_service_read(fd);
+        const string source = jitk::compile_service_read(fd);
+        const string error = service.compile(cmd_template, object, source);
+        if (not error.empty()) {
+            cerr << "[bh_compile_server] Cannot compile " << object << ": " << error << endl;
+        }
+        jitk::compile_service_write(fd, error);
+    } catch (const exception &e) {
+        cerr << "[bh_compile_server] " << e.what() << endl;
+    }
+    close(fd);
+}
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <socket path> [jobs]" << endl;
+        return 1;
+    }
+    const string socket_path = argv[1];
+    const int jobs = argc > 2 ? atoi(argv[2]) : max(1u, thread::hardware_concurrency());
+    if (jobs < 1) {
+        cerr << "[bh_compile_server] The number of jobs must be positive" << endl;
+        return 1;
+    }
+
+    sockaddr_un addr;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        cerr << "[bh_compile_server] The socket path is too long: " << socket_path << endl;
+        return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        perror("[bh_compile_server] socket()");
+        return 1;
+    }
+    unlink(socket_path.c_str()); // Remove the socket of a previous server
+    // The service executes compile commands thus only the owner may connect. NB: we create the socket with the
+    // final permissions since other users could connect before a chmod() after the bind().
+    const mode_t old_umask = umask(S_IRWXG | S_IRWXO);
+    const int bind_ret = bind(server, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    umask(old_umask);
+    if (bind_ret != 0) {
+        perror("[bh_compile_server] bind()");
+        return 1;
+    }
+    if (listen(server, SOMAXCONN) != 0) {
+        perror("[bh_compile_server] listen()");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // The compile commands of the OpenMP engine, which are the only commands the service executes
+    set<string> allowed_cmds;
+    try {
+        const ConfigParser config(-1);
+        for (const char *option: {"compiler_cmd", "compiler_cmd_fast"}) {
+            const string cmd = config.defaultGet<string>("openmp", option, "");
+            if (not cmd.empty()) {
+                allowed_cmds.insert(cmd);
+            }
+        }
+    } catch (const std::exception &e) {
+        cerr << "[bh_compile_server] Cannot read the config file: " << e.what() << endl;
+        return 1;
+    }
+
+    Service service(jobs, std::move(allowed_cmds));
+    while (true) {
+        const int fd = accept(server, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("[bh_compile_server] accept()");
+            return 1;
+        }
+        thread(serve, ref(service), fd).detach();
+    }
+}
@@ -21,11 +21,19 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <map>
 #include <boost/functional/hash.hpp>
 #include <iomanip>
 #include <dlfcn.h>
+#include <unistd.h>
+#include <cstring>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include <bh_memory.h>
+#include <bh_util.hpp>
 #include <jitk/codegen_util.hpp>
 #include <thread>
 
@@ -38,6 +46,82 @@ namespace bohrium {
 
 static boost::hash<string> hasher;
 
+namespace {
+// Returns the number of NUMA nodes or one when unknown
+int count_numa_nodes() {
+    int ret = 0;
+    boost::system::error_code ec;
+    for (fs::directory_iterator it("/sys/devices/system/node", ec), end; not ec and it != end; it.increment(ec)) {
+        const string name = it->path().filename().string();
+        if (name.size() > 4 and name.compare(0, 4, "node") == 0 and isdigit(name[4])) {
+            ++ret;
+        }
+    }
+    return ret > 0 ? ret : 1;
+}
+
+// Returns the maximum number of OpenMP threads
+int max_threads() {
+    const char *env = getenv("OMP_NUM_THREADS");
+    if (env != nullptr and atoi(env) > 0) {
+        return atoi(env);
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Returns the path to the persisted tuning table, which is specific to the compile command and the number of threads
+fs::path tuning_filename(const fs::path &cache_dir, size_t compilation_hash) {
+    if (cache_dir.empty()) {
+        return fs::path();
+    }
+    stringstream ss;
+    ss << "openmp_tuning_" << compilation_hash << "_" << max_threads() << ".txt";
+    return cache_dir / ss.str();
+}
+
+// The headers of the precompiled preamble
+const char *preamble_source =
+    "#include <complex.h>\n"
+    "#include <tgmath.h>\n"
+    "#include <math.h>\n";
+
+// Returns the command that precompiles a header using the flags of the compile command 'cmd_template'.
+// NB: the command must be GCC compatible, we drop the linker flags and compile the input as a C header.
+string preamble_command(const string &cmd_template) {
+    istringstream iss(cmd_template);
+    stringstream ss;
+    string token;
+    bool language = false;
+    while (iss >> token) {
+        if (language) { // The argument of "-x"
+            token = "c-header";
+            language = false;
+        } else if (token == "-x") {
+            language = true;
+        } else if (token == "-shared" or token.compare(0, 2, "-l") == 0 or token.compare(0, 2, "-L") == 0 or
+                   token.compare(0, 4, "-Wl,") == 0) {
+            continue;
+        }
+        ss << token << " ";
+    }
+    return ss.str();
+}
+
+// The source of the kernel that first-touch pages using the same static schedule as the "parallel for" of the
+// generated kernels, which makes the threads own the pages they will access
+const char *first_touch_source =
+    "#include <stdint.h>\n"
+    "void launcher(void* data_list[], uint64_t offset_strides[], void *constants, int nthreads, int schedule,\n"
+    "              int chunk) {\n"
+    "    char *data = data_list[0];\n"
+    "    const uint64_t npages = offset_strides[0], page_size = offset_strides[1];\n"
+    "    #pragma omp parallel for schedule(static)\n"
+    "    for(uint64_t i=0; i < npages; ++i) {\n"
+    "        data[i * page_size] = 0;\n"
+    "    }\n"
+    "}\n";
+}
+
 EngineOpenMP::EngineOpenMP(const ConfigParser &config, jitk::Statistics &stat) :
                                            verbose(config.defaultGet<bool>("verbose", false)),
                                            tmp_dir(jitk::get_tmp_path(config)),
@@ -46,7 +130,27 @@ EngineOpenMP::EngineOpenMP(const ConfigParser &config, jitk::Statistics &stat) :
                                            cache_bin_dir(fs::path(config.defaultGet<string>("cache_dir", ""))),
                                            compiler(config.get<string>("compiler_cmd"), verbose),
                                            compilation_hash(hasher(compiler.cmd_template)),
-                                           stat(stat)
+                                           compiler_fast(config.defaultGet<bool>("tiered_compilation", false) ?
+                                                         config.defaultGet<string>("compiler_cmd_fast", "") : "",
+                                                         verbose),
+                                           fast_compilation_hash(hasher(compiler_fast.cmd_template)),
+                                           tier_up_calls(config.defaultGet<uint64_t>("tier_up_calls", 10)),
+                                           tier_up_time(config.defaultGet<double>("tier_up_time", 0.05)),
+                                           compile_service(cache_bin_dir.empty() ? "" :
+                                                           config.defaultGet<string>("compile_server", ""),
+                                                           config.defaultGet<double>("compile_server_timeout", 60)),
+                                           _preamble(config.defaultGet<bool>("compiler_pch", false) and
+                                                     not cache_bin_dir.empty() ?
+                                                     cache_bin_dir / "bh_kernel_preamble.h" : fs::path()),
+                                           stat(stat),
+                                           pool_limit(config.defaultGet<int64_t>("memory_pool", 0) * 1024 * 1024),
+                                           numa_first_touch(config.defaultGet<bool>("numa_first_touch", false) and
+                                                            config.defaultGet<bool>("compiler_openmp", false)),
+                                           numa_interleave(config.defaultGet<bool>("numa_interleave", false)),
+                                           numa_nodes(count_numa_nodes()),
+                                           autotune(config.defaultGet<bool>("autotune", false)),
+                                           tuner(max_threads(), config.defaultGet<double>("autotune_time_limit", 0.01),
+                                                 tuning_filename(cache_bin_dir, compilation_hash))
 {
     // Let's make sure that the directories exist
     jitk::create_directories(tmp_src_dir);
@@ -54,19 +158,62 @@ EngineOpenMP::EngineOpenMP(const ConfigParser &config, jitk::Statistics &stat) :
     if (not cache_bin_dir.empty()) {
         jitk::create_directories(cache_bin_dir);
     }
+
+    // Thread pinning, which must be set before the OpenMP runtime is loaded by the first kernel.
+    // NB: we never overwrite the user's own OpenMP environment
+    const string proc_bind = config.defaultGet<string>("thread_binding", "");
+    if (not proc_bind.empty()) {
+        setenv("OMP_PROC_BIND", proc_bind.c_str(), 0);
+    }
+    const string places = config.defaultGet<string>("thread_places", "");
+    if (not places.empty()) {
+        setenv("OMP_PLACES", places.c_str(), 0);
+    }
+
+    // Write the preamble, which is precompiled on demand. NB: other processes might share the cache dir
+    if (not _preamble.empty() and not fs::exists(_preamble)) {
+        const fs::path tmp = fs::unique_path(_preamble.string() + ".%%%%-%%%%");
+        {
+            ofstream file(tmp.string());
+            file << preamble_source;
+        }
+        fs::rename(tmp, _preamble);
+    }
+
+    if (config.defaultGet<bool>("worker_pool", false)) {
+        _worker_pool.reset(new WorkerPool(max_threads(), config.defaultGet<bool>("worker_pool_pinning", false),
+                                          config.defaultGet<uint64_t>("worker_pool_spin", 2000)));
+    }
 }
 
 EngineOpenMP::~EngineOpenMP() {
 
+    // Wait for the background compilations to finish
+    for (auto &kernel: _fast_tier) {
+        if (kernel.second.build.valid()) {
+            kernel.second.build.wait();
+        }
+    }
+
+    // Release the memory pool
+    for (const auto &buffers: _pool) {
+        for (void *data: buffers.second) {
+            bh_memory_free(data, buffers.first);
+        }
+    }
+
     // Move JIT kernels to the cache dir
     if (not cache_bin_dir.empty()) {
      //   cout << "filling cache_bin_dir: " << cache_bin_dir.string() << endl;
         for (const auto &kernel: _functions) {
-            const fs::path src = tmp_bin_dir / jitk::hash_filename(compilation_hash, kernel.first, ".so");
-            if (fs::exists(src)) {
-                const fs::path dst = cache_bin_dir / jitk::hash_filename(compilation_hash, kernel.first, ".so");
-                if (not fs::exists(dst)) {
-                    fs::copy(src, dst);
+            // NB: we keep both compilation tiers
+            for (size_t hash: {compilation_hash, fast_compilation_hash}) {
+                const fs::path src = tmp_bin_dir / jitk::hash_filename(hash, kernel.first, ".so");
+                if (fs::exists(src)) {
+                    const fs::path dst = cache_bin_dir / jitk::hash_filename(hash, kernel.first, ".so");
+                    if (not fs::exists(dst)) {
+                        fs::copy(src, dst);
+                    }
                 }
             }
         }
@@ -112,26 +259,79 @@ KernelFunction EngineOpenMP::getFunction(const string &source) {
 
     fs::path binfile = cache_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
 
+    // With tiered compilation, we use the cheap compiler unless the kernel has been recompiled in a previous run
+    const bool tiered = not compiler_fast.cmd_template.empty() and (verbose or cache_bin_dir.empty() or
+                                                                     not fs::exists(binfile));
+    const jitk::Compiler &comp = tiered ? compiler_fast : compiler;
+    const size_t comp_hash = tiered ? fast_compilation_hash : compilation_hash;
+    if (tiered) {
+        binfile = cache_bin_dir / jitk::hash_filename(comp_hash, hash, ".so");
+    }
+
     // If the binary file of the kernel doesn't exist we create it
     if (verbose or cache_bin_dir.empty() or not fs::exists(binfile)) {
         ++stat.kernel_cache_misses;
-
-        // We create the binary file in the tmp dir
-        binfile = tmp_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
+        buildPreamble(comp, comp_hash);
 
         // Write the source file and compile it (reading from disk)
         // NB: this is a nice debug option, but will hurt performance
         if (verbose) {
+            binfile = tmp_bin_dir / jitk::hash_filename(comp_hash, hash, ".so");
             fs::path srcfile = jitk::write_source2file(source, tmp_src_dir,
-                                                       jitk::hash_filename(compilation_hash, hash, ".c"),
+                                                       jitk::hash_filename(comp_hash, hash, ".c"),
                                                        true);
-            compiler.compile(binfile.string(), srcfile.string());
+            comp.compile(binfile.string(), srcfile.string());
         } else {
-            // Pipe the source directly into the compiler thus no source file is written
-            compiler.compile(binfile.string(), source.c_str(), source.size());
+            binfile = compileFunction(comp, comp_hash, hash, source);
         }
     }
+    if (tiered) {
+        _fast_tier[hash].source = source;
+    }
+    return loadFunction(hash, binfile);
+}
+
+fs::path EngineOpenMP::compileFunction(const jitk::Compiler &comp, size_t comp_hash, uint64_t hash,
+                                       const string &source) const {
+    // The compile service publishes the binary file in the cache dir, which other processes might be waiting for
+    const fs::path cachefile = cache_bin_dir / jitk::hash_filename(comp_hash, hash, ".so");
+    if (compile_service.enabled() and compile_service.compile(comp.cmd_template, cachefile.string(), source)) {
+        return cachefile;
+    }
+
+    // Otherwise, we create the binary file in the tmp dir
+    // NB: we pipe the source directly into the compiler thus no source file is written
+    const fs::path binfile = tmp_bin_dir / jitk::hash_filename(comp_hash, hash, ".so");
+    comp.compile(binfile.string(), source.c_str(), source.size());
+    return binfile;
+}
+
+void EngineOpenMP::buildPreamble(const jitk::Compiler &comp, size_t comp_hash) {
+    if (_preamble.empty() or util::exist(_preamble_builds, comp_hash)) {
+        return;
+    }
+    _preamble_builds.insert(comp_hash);
+
+    // The compiler picks the valid precompiled header in the "<header>.gch" directory, which contains one per
+    // compile command. Thus, a missing or invalid precompiled header makes the compiler read the header itself.
+    const fs::path gch_dir = _preamble.string() + ".gch";
+    const fs::path gch = gch_dir / jitk::hash_filename(comp_hash, 0, ".gch");
+    if (fs::exists(gch)) {
+        return;
+    }
+    jitk::create_directories(gch_dir);
+    const fs::path tmp = fs::unique_path(_preamble.string() + ".%%%%-%%%%.gch");
+    try {
+        jitk::Compiler(preamble_command(comp.cmd_template), verbose).compile(tmp.string(), _preamble.string());
+        fs::rename(tmp, gch);
+    } catch (const runtime_error &e) {
+        cerr << "[OpenMP] Warning: cannot precompile the kernel preamble: " << e.what() << endl;
+        boost::system::error_code ec;
+        fs::remove(tmp, ec);
+    }
+}
 
+KernelFunction EngineOpenMP::loadFunction(uint64_t hash, const fs::path &binfile) {
     // Load the shared library
     void *lib_handle = dlopen(binfile.string().c_str(), RTLD_NOW);
     if (lib_handle == nullptr) {
@@ -150,18 +350,61 @@ KernelFunction EngineOpenMP::getFunction(const string &source) {
         cerr << "Cannot load function launcher(): " << dlsym_error << endl;
         throw runtime_error("VE-OPENMP: Cannot load function launcher()");
     }
+    _function_hashes[_functions.at(hash)] = hash;
+
+    // Load the range launcher, which only kernels parallelized at the outermost loop have
+    if (_worker_pool) {
+        KernelRangeFunction range_func;
+        *(void **) (&range_func) = dlsym(lib_handle, "launcher_range");
+        const uint64_t *range_size = (const uint64_t *) dlsym(lib_handle, "launcher_range_size");
+        if (range_func != nullptr and range_size != nullptr) {
+            _range_functions[_functions.at(hash)] = make_pair(range_func, *range_size);
+        }
+        dlerror(); // Reset errors
+    }
     return _functions.at(hash);
 }
 
+void EngineOpenMP::recordTierCall(uint64_t hash, double seconds) {
+    auto it = _fast_tier.find(hash);
+    if (it == _fast_tier.end()) {
+        return;
+    }
+    FastTier &kernel = it->second;
+
+    // Replace the kernel when the background compilation is done. NB: the old library is never unloaded thus
+    // function pointers to the old kernel (e.g. in the plan cache) stay valid and are redirected by launch()
+    if (kernel.build.valid()) {
+        if (kernel.build.wait_for(chrono::seconds(0)) == future_status::ready) {
+            try {
+                loadFunction(hash, kernel.build.get());
+                ++stat.kernel_tier_ups;
+            } catch (const runtime_error &e) {
+                cerr << "[OpenMP] Warning: the recompilation of a kernel failed, we keep using the cheap one: "
+                     << e.what() << endl;
+            }
+            _fast_tier.erase(it);
+        }
+        return;
+    }
 
-void EngineOpenMP::execute(const std::string &source, const std::vector<bh_base*> &non_temps,
-                           const std::vector<const bh_view*> &offset_strides,
-                           const std::vector<const bh_instruction*> &constants) {
-
-    // Make sure all arrays are allocated
-    for (bh_base *base: non_temps) {
-        bh_data_malloc(base);
+    // Recompile the kernel in the background when it becomes hot
+    ++kernel.calls;
+    kernel.time += seconds;
+    if (kernel.calls >= tier_up_calls or kernel.time >= tier_up_time) {
+        buildPreamble(compiler, compilation_hash);
+        const string source = std::move(kernel.source);
+        kernel.source.clear();
+        kernel.build = std::async(std::launch::async, [this, hash, source]() {
+            return compileFunction(compiler, compilation_hash, hash, source);
+        });
     }
+}
+
+
+KernelFunction EngineOpenMP::execute(const std::string &source, const std::vector<bh_base*> &non_temps,
+                                     const std::vector<const bh_view*> &offset_strides,
+                                     const std::vector<const bh_instruction*> &constants) {
 
     // Compile the kernel
     auto tbuild = chrono::steady_clock::now();
@@ -169,15 +412,7 @@ void EngineOpenMP::execute(const std::string &source, const std::vector<bh_base*
     assert(func != NULL);
     stat.time_compile += chrono::steady_clock::now() - tbuild;
 
-    // Create a 'data_list' of data pointers
-    vector<void*> data_list;
-    data_list.reserve(non_temps.size());
-    for(bh_base *base: non_temps) {
-        assert(base->data != NULL);
-        data_list.push_back(base->data);
-    }
-
-    // And the offset-and-strides
+    // Create the offset-and-strides
     vector<uint64_t> offset_and_strides;
     offset_and_strides.reserve(offset_strides.size());
     for (const bh_view *view: offset_strides) {
@@ -196,11 +431,63 @@ void EngineOpenMP::execute(const std::string &source, const std::vector<bh_base*
         constant_arg.push_back(instr->constant.value);
     }
 
+    launch(func, non_temps, offset_and_strides, constant_arg);
+    return func;
+}
+
+void EngineOpenMP::launch(KernelFunction func, const std::vector<bh_base*> &non_temps,
+                          std::vector<uint64_t> &offset_and_strides, std::vector<bh_constant_value> &constants) {
+
+    // Make sure all arrays are allocated
+    for (bh_base *base: non_temps) {
+        allocBase(base);
+    }
+
+    // The kernel might have been recompiled since 'func' was returned by execute()
+    const uint64_t hash = _function_hashes.at(func);
+    func = _functions.at(hash);
+
+    // Create a 'data_list' of data pointers
+    vector<void*> data_list;
+    data_list.reserve(non_temps.size());
+    for(bh_base *base: non_temps) {
+        assert(base->data != NULL);
+        data_list.push_back(base->data);
+    }
+
+    // The worker pool executes the ranges of the outermost loop instead of an OpenMP parallel region
+    if (_worker_pool) {
+        auto it = _range_functions.find(func);
+        if (it != _range_functions.end()) {
+            const KernelRangeFunction range_func = it->second.first;
+            auto texec = chrono::steady_clock::now();
+            _worker_pool->run(it->second.second, [&](uint64_t begin, uint64_t end) {
+                range_func(&data_list[0], &offset_and_strides[0], &constants[0], begin, end);
+            });
+            const chrono::duration<double> elapsed = chrono::steady_clock::now() - texec;
+            stat.time_exec += elapsed;
+            ++stat.worker_pool_launches;
+            recordTierCall(hash, elapsed.count());
+            return;
+        }
+    }
+
+    // The parallelism of the call, which is the OpenMP default unless tuned
+    Parallelism parallelism = {0, 0, 0};
+    if (autotune) {
+        parallelism = tuner.get(hash);
+    }
+
     auto texec = chrono::steady_clock::now();
     // Call the launcher function, which will execute the kernel
-    func(&data_list[0], &offset_and_strides[0], &constant_arg[0]);
-    stat.time_exec += chrono::steady_clock::now() - texec;
-
+    func(&data_list[0], &offset_and_strides[0], &constants[0], parallelism.nthreads, parallelism.schedule,
+         parallelism.chunk);
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - texec;
+    stat.time_exec += elapsed;
+    if (autotune) {
+        tuner.record(hash, elapsed.count());
+    }
+    recordTierCall(hash, elapsed.count());
 }
 
 void EngineOpenMP::set_constructor_flag(std::vector<bh_instruction*> &instr_list) {
@@ -209,6 +496,109 @@ void EngineOpenMP::set_constructor_flag(std::vector<bh_instruction*> &instr_list
 }
 
 
+namespace {
+// Returns 'nbytes' rounded up to whole pages, which is the size that 'bh_memory_malloc()' actually maps
+int64_t page_rounded_size(int64_t nbytes) {
+    static const int64_t page_size = sysconf(_SC_PAGESIZE);
+    return (nbytes + page_size - 1) / page_size * page_size;
+}
+}
+
+void EngineOpenMP::allocBase(bh_base *base) {
+    if (base == nullptr or base->data != nullptr) {
+        return;
+    }
+    const int64_t nbytes = page_rounded_size(bh_base_size(base));
+    ++stat.memory_allocations;
+    auto it = _pool.find(nbytes);
+    if (it != _pool.end() and not it->second.empty()) {
+        base->data = it->second.back();
+        it->second.pop_back();
+        _pool_size -= nbytes;
+        ++stat.memory_pool_hits;
+    } else {
+        bh_data_malloc(base);
+        placePages(base->data, bh_base_size(base));
+    }
+}
+
+void EngineOpenMP::placePages(void *data, int64_t nbytes) {
+    if (data == nullptr or numa_nodes < 2) {
+        return;
+    }
+    static const int64_t page_size = sysconf(_SC_PAGESIZE);
+    const uint64_t npages = static_cast<uint64_t>((nbytes + page_size - 1) / page_size);
+
+#ifdef __linux__
+    // Interleave the pages round-robin between all nodes, which evens out the bandwidth of arrays
+    // shared by all threads. NB: we call mbind() through syscall() to avoid a dependency on libnuma
+    if (numa_interleave) {
+        constexpr int mpol_interleave = 3;
+        unsigned long nodemask = numa_nodes >= 64 ? ~0UL : (1UL << numa_nodes) - 1;
+        if (syscall(SYS_mbind, data, npages * page_size, mpol_interleave, &nodemask, sizeof(nodemask) * 8, 0) != 0
+            and verbose) {
+            cerr << "[OpenMP] mbind() failed: " << strerror(errno) << endl;
+        }
+        return;
+    }
+#endif
+    // Parallel first-touch, which places each page at the node of the thread that will access it
+    if (numa_first_touch and npages > 1) {
+        if (_first_touch == nullptr) {
+            _first_touch = getFunction(first_touch_source);
+        }
+        void *data_list[] = {data};
+        uint64_t args[] = {npages, static_cast<uint64_t>(page_size)};
+        _first_touch(data_list, args, nullptr, 0, 0, 0);
+    }
+}
+
+int EngineOpenMP::maxThreads() const {
+    return max_threads();
+}
+
+void EngineOpenMP::recordNumaStatistics() {
+    stat.numa_node_bytes.clear();
+    ifstream file("/proc/self/numa_maps");
+    string line;
+    while (getline(file, line)) {
+        // A line consist of space separated fields, e.g. "7f3a0000 default anon=512 N0=256 N1=256 kernelpagesize_kB=4"
+        stringstream ss(line);
+        string field;
+        map<int, uint64_t> pages;
+        uint64_t pagesize_kb = 4;
+        while (ss >> field) {
+            if (field.size() > 2 and field[0] == 'N' and isdigit(field[1])) {
+                const size_t eq = field.find('=');
+                if (eq != string::npos) {
+                    pages[stoi(field.substr(1, eq - 1))] += stoull(field.substr(eq + 1));
+                }
+            } else if (field.compare(0, 18, "kernelpagesize_kB=") == 0) {
+                pagesize_kb = stoull(field.substr(18));
+            }
+        }
+        for (const auto &p: pages) {
+            stat.numa_node_bytes[p.first] += p.second * pagesize_kb * 1024;
+        }
+    }
+}
+
+void EngineOpenMP::freeBase(bh_base *base) {
+    if (base == nullptr or base->data == nullptr) {
+        return;
+    }
+    // NB: since the pool is keyed by the page-rounded size, a reused buffer can still be freed
+    //     using 'bh_memory_free()' and the size of its new base array
+    const int64_t nbytes = page_rounded_size(bh_base_size(base));
+    if (nbytes > 0 and _pool_size + nbytes <= pool_limit) {
+        _pool[nbytes].push_back(base->data);
+        _pool_size += nbytes;
+        base->data = nullptr;
+    } else {
+        bh_data_free(base);
+    }
+}
+
 std::string EngineOpenMP::info() const {
     stringstream ss;
     ss << "----"                                                           << "\n";
@@ -25,16 +25,32 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include <string>
 #include <map>
+#include <set>
+#include <memory>
+#include <future>
 #include <boost/filesystem.hpp>
 
 #include <bh_config_parser.hpp>
 #include <jitk/statistics.hpp>
 #include <jitk/block.hpp>
 #include <jitk/compiler.hpp>
+#include <jitk/compile_service.hpp>
+#include <jitk/plan_cache.hpp>
+
+#include "kernel_tuner.hpp"
+#include "worker_pool.hpp"
 
 namespace bohrium {
 
-typedef void (*KernelFunction)(void* data_list[], uint64_t offset_strides[], bh_constant_value constants[]);
+// The launcher of a kernel. 'nthreads', 'schedule', and 'chunk' are the parallelism to use (zero means the
+// OpenMP default), see 'Parallelism'
+typedef void (*KernelFunction)(void* data_list[], uint64_t offset_strides[], bh_constant_value constants[],
+                               int nthreads, int schedule, int chunk);
+typedef jitk::PlanCache<KernelFunction> PlanCacheOpenMP;
+
+// The launcher of the iterations [begin, end) of the outermost loop of a kernel, which the worker pool calls
+typedef void (*KernelRangeFunction)(void* data_list[], uint64_t offset_strides[], bh_constant_value constants[],
+                                    uint64_t begin, uint64_t end);
 
 class EngineOpenMP {
   private:
@@ -62,22 +78,121 @@ class EngineOpenMP {
     // The hash of the JIT compilation command
     const size_t compilation_hash;
 
+    // Tiered compilation: new kernels are compiled using the cheap 'compiler_fast' and recompiled in the background
+    // using 'compiler' when they become hot. Disabled when the command of 'compiler_fast' is empty
+    const jitk::Compiler compiler_fast;
+    const size_t fast_compilation_hash;
+    const uint64_t tier_up_calls;
+    const double tier_up_time;
+
+    // The local compile service, which compiles kernels into 'cache_bin_dir' on behalf of all processes
+    // (disabled when the socket path is empty or when there is no cache dir)
+    const jitk::CompileService compile_service;
+
+    // The header of the type-generic math headers in 'cache_bin_dir', which is precompiled once per compile
+    // command (empty when disabled)
+    const boost::filesystem::path _preamble;
+
+    // The hashes of the compile commands whose precompiled preamble exists (or failed to build)
+    std::set<size_t> _preamble_builds;
+
+    // The kernels compiled using 'compiler_fast' that haven't been recompiled yet
+    struct FastTier {
+        // The source of the kernel (cleared when the background compilation starts)
+        std::string source;
+        // Number of calls and the total execution time of the kernel so far
+        uint64_t calls = 0;
+        double time = 0;
+        // The background compilation using 'compiler', which returns the path to the shared library
+        std::future<boost::filesystem::path> build;
+    };
+    std::map<uint64_t, FastTier> _fast_tier;
+
     // Some statistics
     jitk::Statistics &stat;
 
+    // Pool of released data buffers, which new base arrays of the same page-rounded size reuse
+    std::map<int64_t, std::vector<void*> > _pool;
+
+    // The total size of the buffers in the pool and the maximum size allowed (in bytes)
+    int64_t _pool_size = 0;
+    const int64_t pool_limit;
+
+    // NUMA placement of new arrays: first-touch in the static schedule of the kernels and/or interleaving
+    const bool numa_first_touch;
+    const bool numa_interleave;
+
+    // The number of NUMA nodes of the machine
+    const int numa_nodes;
+
+    // The kernel that first-touch the pages of new arrays (compiled on demand)
+    KernelFunction _first_touch = nullptr;
+
+    // Tune the parallelism of each kernel at runtime
+    const bool autotune;
+    KernelTuner tuner;
+
+    // The hash of each kernel function, which identifies the kernel in the tuner
+    std::map<KernelFunction, uint64_t> _function_hashes;
+
+    // The worker pool that executes the range launchers of the kernels (null when disabled)
+    std::unique_ptr<WorkerPool> _worker_pool;
+
+    // The range launcher and the size of the outermost loop of the kernel functions that support ranges
+    std::map<KernelFunction, std::pair<KernelRangeFunction, uint64_t> > _range_functions;
+
     // Return a kernel function based on the given 'source'
     KernelFunction getFunction(const std::string &source);
 
+    // Precompile the preamble using the flags of 'comp', whose command hash is 'comp_hash' (if not already done)
+    void buildPreamble(const jitk::Compiler &comp, size_t comp_hash);
+
+    // Compile the kernel 'source', whose hash is 'hash', using 'comp', whose command hash is 'comp_hash'.
+    // Returns the path to the shared library, which is in 'cache_bin_dir' when the compile service did the work.
+    // NB: thread-safe thus background compilations may call it
+    boost::filesystem::path compileFunction(const jitk::Compiler &comp, size_t comp_hash, uint64_t hash,
+                                            const std::string &source) const;
+
+    // Load the kernel function 'hash' from the shared library 'binfile'
+    KernelFunction loadFunction(uint64_t hash, const boost::filesystem::path &binfile);
+
+    // Record a call of the kernel function 'hash' that took 'seconds', which might recompile the kernel using
+    // the aggressive compiler or replace the kernel with the recompiled one
+    void recordTierCall(uint64_t hash, double seconds);
+
+    // Place the pages of the newly allocated 'data' of 'nbytes' bytes on the NUMA nodes
+    void placePages(void *data, int64_t nbytes);
+
   public:
     EngineOpenMP(const ConfigParser &config, jitk::Statistics &stat);
     ~EngineOpenMP();
 
     // The following methods implements the methods required by jitk::handle_cpu_execution()
 
-    void execute(const std::string &source, const std::vector<bh_base*> &non_temps,
-                 const std::vector<const bh_view*> &offset_strides,
-                 const std::vector<const bh_instruction*> &constants);
+    // Compile (if needed) and execute the kernel 'source'. Returns the launcher function of the kernel
+    KernelFunction execute(const std::string &source, const std::vector<bh_base*> &non_temps,
+                           const std::vector<const bh_view*> &offset_strides,
+                           const std::vector<const bh_instruction*> &constants);
+    // Execute the launcher function 'func' of an already compiled kernel
+    void launch(KernelFunction func, const std::vector<bh_base*> &non_temps,
+                std::vector<uint64_t> &offset_and_strides, std::vector<bh_constant_value> &constants);
     void set_constructor_flag(std::vector<bh_instruction*> &instr_list);
+    // Allocate the data of 'base' (if not already allocated), which might reuse a buffer from the pool
+    void allocBase(bh_base *base);
+    // Free the data of 'base', which might release the buffer to the pool
+    void freeBase(bh_base *base);
+
+    // Return the maximum number of threads of the kernels
+    int maxThreads() const;
+
+    // Return the path to the precompiled preamble, which kernels should include first instead of the type-generic
+    // math headers. Returns the empty path when there isn't any preamble.
+    const boost::filesystem::path &preamble() const {
+        return _preamble;
+    }
+
+    // Record the amount of memory of this process that is allocated on each NUMA node
+    void recordNumaStatistics();
 
     // Return a YAML string describing this component
     std::string info() const;
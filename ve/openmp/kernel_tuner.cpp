@@ -0,0 +1,122 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <limits>
+#include <algorithm>
+#include <boost/filesystem/operations.hpp>
+
+#include "kernel_tuner.hpp"
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace bohrium {
+
+namespace {
+// The schedule kinds of OpenMP (omp_sched_t)
+constexpr int omp_sched_static = 1;
+constexpr int omp_sched_dynamic = 2;
+constexpr int omp_sched_guided = 3;
+}
+
+KernelTuner::KernelTuner(int max_threads, double time_limit, fs::path filename) : time_limit(time_limit),
+                                                                                filename(std::move(filename)) {
+    max_threads = std::max(max_threads, 1);
+    _candidates.push_back({max_threads, omp_sched_static, 0});
+    _candidates.push_back({max_threads, omp_sched_dynamic, 64});
+    _candidates.push_back({max_threads, omp_sched_guided, 0});
+    for (int nthreads: {max_threads / 2, max_threads / 4, 1}) {
+        if (nthreads > 0 and nthreads < _candidates.back().nthreads) {
+            _candidates.push_back({nthreads, omp_sched_static, 0});
+        }
+    }
+
+    // Load the persisted tuning table, which consist of lines of "<hash> <nthreads> <schedule> <chunk>"
+    if (not this->filename.empty()) {
+        ifstream file(this->filename.string());
+        uint64_t hash;
+        Parallelism p;
+        while (file >> hash >> p.nthreads >> p.schedule >> p.chunk) {
+            Entry &e = _entries[hash];
+            e.done = true;
+            e.best = p;
+        }
+    }
+}
+
+KernelTuner::~KernelTuner() {
+    if (filename.empty()) {
+        return;
+    }
+    // We write to a temporary file and then rename it, which makes concurrent executions safe
+    const fs::path tmp = fs::path(filename.string() + ".tmp" + fs::unique_path().string());
+    {
+        ofstream file(tmp.string());
+        for (const auto &e: _entries) {
+            if (e.second.done) {
+                const Parallelism &p = e.second.best;
+                file << e.first << " " << p.nthreads << " " << p.schedule << " " << p.chunk << "\n";
+            }
+        }
+    }
+    boost::system::error_code ec;
+    fs::rename(tmp, filename, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+    }
+}
+
+const Parallelism &KernelTuner::get(uint64_t hash) {
+    const Entry &e = _entries[hash];
+    if (e.done) {
+        return e.best;
+    }
+    return _candidates[e.calls % _candidates.size()];
+}
+
+void KernelTuner::record(uint64_t hash, double seconds) {
+    Entry &e = _entries[hash];
+    if (e.done) {
+        return;
+    }
+    if (e.times.empty()) {
+        e.times.resize(_candidates.size(), numeric_limits<double>::max());
+    }
+    const size_t i = e.calls % _candidates.size();
+    e.times[i] = std::min(e.times[i], seconds);
+    ++e.calls;
+
+    // Large kernels keep the default parallelism
+    if (i == 0 and seconds > time_limit) {
+        e.done = true;
+        e.best = _candidates[0];
+        e.times.clear();
+        return;
+    }
+    if (e.calls == rounds * _candidates.size()) {
+        const size_t best = std::min_element(e.times.begin(), e.times.end()) - e.times.begin();
+        e.done = true;
+        e.best = _candidates[best];
+        e.times.clear();
+    }
+}
+
+} // bohrium
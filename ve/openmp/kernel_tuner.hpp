@@ -0,0 +1,81 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __BH_VE_OPENMP_KERNEL_TUNER_HPP
+#define __BH_VE_OPENMP_KERNEL_TUNER_HPP
+
+#include <map>
+#include <vector>
+#include <string>
+#include <boost/filesystem/path.hpp>
+
+namespace bohrium {
+
+// The parallelism of a kernel call, which is given to the launcher of the kernel
+struct Parallelism {
+    // Number of OpenMP threads
+    int nthreads;
+    // The OpenMP schedule kind (omp_sched_t) and chunk size, which the "schedule(runtime)" loops use
+    int schedule;
+    int chunk;
+};
+
+// The tuner finds the fastest parallelism of each kernel (identified by its hash) by trying
+// the candidates on the first calls of the kernel. The result is persisted in 'filename'.
+class KernelTuner {
+  private:
+    struct Entry {
+        // Number of calls recorded so far (while tuning)
+        size_t calls = 0;
+        // The fastest time of each candidate
+        std::vector<double> times;
+        // The tuning is done and 'best' is the parallelism to use
+        bool done = false;
+        Parallelism best;
+    };
+    std::map<uint64_t, Entry> _entries;
+
+    // The candidates where the first one is the default (all threads and a static schedule)
+    std::vector<Parallelism> _candidates;
+
+    // Kernels slower than 'time_limit' seconds using the default parallelism aren't tuned,
+    // since they are dominated by the computation and trying other candidates is expensive
+    const double time_limit;
+
+    // The number of times each candidate is tried
+    static constexpr size_t rounds = 2;
+
+    // The file of the persisted tuning table (empty means no persistence)
+    const boost::filesystem::path filename;
+
+  public:
+    KernelTuner(int max_threads, double time_limit, boost::filesystem::path filename);
+    ~KernelTuner();
+
+    // Returns the parallelism of the next call of the kernel 'hash'
+    const Parallelism &get(uint64_t hash);
+
+    // Record the execution time (in seconds) of the call of the kernel 'hash' that used get()
+    void record(uint64_t hash, double seconds);
+};
+
+} // bohrium
+
+#endif
@@ -18,9 +18,11 @@ GNU Lesser General Public License along with Bohrium.
 If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
 #include <numeric>
 #include <chrono>
+#include <unistd.h>
 
 #include <bh_component.hpp>
 #include <bh_extmethod.hpp>
@@ -29,6 +31,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <jitk/fuser.hpp>
 #include <jitk/block.hpp>
 #include <jitk/instruction.hpp>
+#include <jitk/view.hpp>
 #include <jitk/graph.hpp>
 #include <jitk/transformer.hpp>
 #include <jitk/fuser_cache.hpp>
@@ -52,17 +55,23 @@ class Impl : public ComponentImpl {
     Statistics stat;
     // Fuse cache
     FuseCache fcache;
+    // Execution plan cache
+    PlanCacheOpenMP pcache;
     // Teh OpenMP engine
     EngineOpenMP engine;
     // Known extension methods
     map<bh_opcode, extmethod::ExtmethodFace> extmethods;
+    // The number of bytes of the output of a BLAS gemm to compute before applying the following element-wise
+    // instructions (zero disables the tiling)
+    const uint64_t gemm_tile;
     //Allocated base arrays
     set<bh_base*> _allocated_bases;
 
   public:
     Impl(int stack_level) : ComponentImpl(stack_level),
                             stat(config.defaultGet("prof", false)),
-                            fcache(stat), engine(config, stat) {}
+                            fcache(stat), pcache(stat, config.defaultGet<uint64_t>("plan_cache_size", 1024)), engine(config, stat),
+                            gemm_tile(config.defaultGet<uint64_t>("gemm_tile", 0)) {}
     ~Impl();
     void execute(bh_ir *bhir);
     void extmethod(const string &name, bh_opcode opcode) {
@@ -73,7 +82,7 @@ class Impl : public ComponentImpl {
 
     // Implement the handle of extension methods
     void handle_extmethod(bh_ir *bhir) {
-        util_handle_extmethod(this, bhir, extmethods);
+        util_handle_extmethod(this, bhir, extmethods, gemm_tile);
     }
 
     // The following methods implements the methods required by jitk::handle_gpu_execution()
@@ -88,6 +97,7 @@ class Impl : public ComponentImpl {
         if (msg == "statistic_enable_and_reset") {
             stat = Statistics(true, config.defaultGet("prof", false));
         } else if (msg == "statistic") {
+            engine.recordNumaStatistics();
             stat.write("OpenMP", "", ss);
             return ss.str();
         } else if (msg == "info") {
@@ -102,7 +112,7 @@ class Impl : public ComponentImpl {
             throw runtime_error("OpenMP - get_mem_ptr(): `copy2host` is not True");
         }
         if (force_alloc) {
-            bh_data_malloc(&base);
+            engine.allocBase(&base);
         }
         void *ret = base.data;
         if (nullify) {
@@ -141,12 +151,16 @@ extern "C" void destroy(ComponentImpl* self) {
 
 Impl::~Impl() {
     if (stat.print_on_exit) {
+        engine.recordNumaStatistics();
         stat.write("OpenMP", config.defaultGet<std::string>("prof_filename", ""), cout);
     }
 }
 
-// Writing the OpenMP header, which include "parallel for" and "simd"
-void write_openmp_header(const SymbolTable &symbols, Scope &scope, const LoopB &block, const ConfigParser &config, stringstream &out) {
+// Writing the OpenMP header, which include "parallel for" (when 'parallel_for') and "simd"
+// When 'fence_nontemporal', a parallel for is split into a parallel region and a "for nowait" such that
+// loop_tail_writer() can fence the non-temporal stores of each thread before the barrier of the region.
+void write_openmp_header(const SymbolTable &symbols, Scope &scope, const LoopB &block, const ConfigParser &config,
+                         bool parallel_for, stringstream &out, bool fence_nontemporal = false) {
     if (not config.defaultGet<bool>("compiler_openmp", false)) {
         return;
     }
@@ -156,9 +170,11 @@ void write_openmp_header(const SymbolTable &symbols, Scope &scope, const LoopB &
     vector<InstrPtr> openmp_reductions;
 
     stringstream ss;
-    // "OpenMP for" goes to the outermost loop
-    if (block.rank == 0 and openmp_compatible(block)) {
-        ss << " parallel for";
+    bool is_parallel_for = false;
+    // "OpenMP for" goes to the loop found by find_parallel_loops()
+    if (parallel_for) {
+        ss << (fence_nontemporal ? " for" : " parallel for");
+        is_parallel_for = true;
         // Since we are doing parallel for, we should either do OpenMP reductions or protect the sweep instructions
         for (const InstrPtr &instr: block._sweeps) {
             assert(instr->operand.size() == 3);
@@ -183,6 +199,21 @@ void write_openmp_header(const SymbolTable &symbols, Scope &scope, const LoopB &
         }
     }
 
+    // The launcher sets the number of threads and the schedule of the "OpenMP for"
+    const bool autotune = is_parallel_for and config.defaultGet<bool>("autotune", false);
+    if (is_parallel_for and fence_nontemporal) {
+        out << "#pragma omp parallel" << (autotune ? " num_threads(bh_nthreads)" : "") << "\n";
+        spaces(out, 4 + block.rank*4);
+        out << "{\n";
+        spaces(out, 4 + block.rank*4);
+        ss << " nowait";
+        if (autotune) {
+            ss << " schedule(runtime)";
+        }
+    } else if (autotune) {
+        ss << " num_threads(bh_nthreads) schedule(runtime)";
+    }
+
     //Let's write the OpenMP reductions
     for (const InstrPtr instr: openmp_reductions) {
         assert(instr->operand.size() == 3);
@@ -197,9 +228,25 @@ void write_openmp_header(const SymbolTable &symbols, Scope &scope, const LoopB &
     }
 }
 
+// Returns true when 'block' is written as an OpenMP parallel for
+bool is_parallel_for(const LoopB &block, const ConfigParser &config, bool loop_is_peeled,
+                     const vector<const LoopB *> &threaded_blocks) {
+    int64_t for_loop_size = block.size;
+    if (block._sweeps.size() > 0 and loop_is_peeled) // If the for-loop has been peeled, its size is one less
+        --for_loop_size;
+    // No need to parallel one-sized loops
+    if (for_loop_size <= 1 or not config.defaultGet<bool>("compiler_openmp", false)) {
+        return false;
+    }
+    // Notice that we use find_if() with a lambda function since 'threaded_blocks' contains pointers not objects
+    return std::find_if(threaded_blocks.begin(), threaded_blocks.end(),
+                        [&block](const LoopB* b){return *b == block;}) != threaded_blocks.end();
+}
+
 // Writes the OpenMP specific for-loop header
+// When 'fence_nontemporal', parallel loops open a parallel region that loop_tail_writer() closes
 void loop_head_writer(const SymbolTable &symbols, Scope &scope, const LoopB &block, const ConfigParser &config, bool loop_is_peeled,
-                      const vector<const LoopB *> &threaded_blocks, stringstream &out) {
+                      const vector<const LoopB *> &threaded_blocks, stringstream &out, bool fence_nontemporal = false) {
 
     // Let's write the OpenMP loop header
     {
@@ -208,7 +255,8 @@ void loop_head_writer(const SymbolTable &symbols, Scope &scope, const LoopB &blo
             --for_loop_size;
         // No need to parallel one-sized loops
         if (for_loop_size > 1) {
-            write_openmp_header(symbols, scope, block, config, out);
+            const bool parallel_for = is_parallel_for(block, config, loop_is_peeled, threaded_blocks);
+            write_openmp_header(symbols, scope, block, config, parallel_for, out, fence_nontemporal);
         }
     }
 
@@ -223,94 +271,637 @@ void loop_head_writer(const SymbolTable &symbols, Scope &scope, const LoopB &blo
     out << itername << " < " << block.size << "; ++" << itername << ") {\n";
 }
 
+// Closes the parallel region that loop_head_writer() opens for a parallel loop with non-temporal stores.
+// Non-temporal stores are weakly ordered thus every thread fences its own stores before the barrier of the region.
+void loop_tail_writer(const LoopB &block, const ConfigParser &config, bool loop_is_peeled,
+                      const vector<const LoopB *> &threaded_blocks, stringstream &out) {
+    if (is_parallel_for(block, config, loop_is_peeled, threaded_blocks)) {
+        spaces(out, 4 + block.rank*4);
+        out << "BH_STREAM_FENCE();\n";
+        spaces(out, 4 + block.rank*4);
+        out << "}\n";
+    }
+}
+
+// Returns true when the iterations of 'block', which is nested in 'ancestors' of the outermost loop 'top', can run
+// in parallel. Besides having no sweeps, every output must either be an array in memory or private to each iteration.
+// Thus, we reject the scalar replaced reduction outputs of 'ancestors' and the temporary arrays declared outside 'block'.
+bool parallel_safe(const LoopB &block, const LoopB &top, const vector<const LoopB*> &ancestors) {
+    if (not block._sweeps.empty() or block.isSystemOnly()) {
+        return false;
+    }
+    set<bh_base*> sweep_outputs;
+    for (const LoopB *b: ancestors) {
+        for (const InstrPtr &instr: b->_sweeps) {
+            // Reductions over the innermost axis are scalar replaced, see write_loop_block()
+            if (bh_opcode_is_reduction(instr->opcode) and instr->sweep_axis() == instr->operand[1].ndim - 1) {
+                sweep_outputs.insert(instr->operand[0].base);
+            }
+        }
+    }
+    const set<bh_base*> top_temps = top.getAllTemps();
+    const set<bh_base*> block_temps = block.getAllTemps();
+    for (const InstrPtr &instr: block.getAllInstr()) {
+        if (bh_opcode_is_system(instr->opcode) or instr->operand.empty()) {
+            continue;
+        }
+        bh_base *base = instr->operand[0].base;
+        if (util::exist(sweep_outputs, base) or (util::exist(top_temps, base) and not util::exist(block_temps, base))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Finds the outermost loops in 'block' that can run in parallel and have at least 'min_size' iterations
+void find_inner_parallel_loops(const LoopB &block, const LoopB &top, vector<const LoopB*> &ancestors,
+                               int64_t min_size, vector<const LoopB*> &out) {
+    ancestors.push_back(&block);
+    for (const LoopB *b: block.getLocalSubBlocks()) {
+        if (b->size >= min_size and parallel_safe(*b, top, ancestors)) {
+            out.push_back(b);
+        } else {
+            find_inner_parallel_loops(*b, top, ancestors, min_size, out);
+        }
+    }
+    ancestors.pop_back();
+}
+
+// Returns the loops of the outermost loop 'block' that get the "OpenMP for". Normally, it is the outermost
+// loop, which gives little or no parallelism when it is short (e.g. shape (2, 100000000)) or sweeps (e.g. a reduction
+// over the outer axis). In that case, we parallelize the outermost inner loop that is long enough to keep all
+// 'nthreads' threads busy.
+// NB: we cannot use collapse(n) since the declarations of a nest are written between the loop headers
+vector<const LoopB*> find_parallel_loops(const LoopB &block, int nthreads, const ConfigParser &config) {
+    if (not config.defaultGet<bool>("parallel_loop_selection", false)) {
+        if (openmp_compatible(block)) {
+            return {&block};
+        }
+        return {};
+    }
+    // We want at least a couple of iterations per thread in order to balance the load
+    const int64_t min_size = 4 * static_cast<int64_t>(nthreads);
+
+    // In a nest without sweeps, every loop can run in parallel. We choose the outermost long loop or the longest loop.
+    const vector<const LoopB*> nest = util_find_threaded_blocks(block).first;
+    if (not nest.empty()) {
+        const LoopB *ret = nest[0];
+        for (const LoopB *b: nest) {
+            if (b->size >= min_size) {
+                return {b};
+            }
+            if (b->size > ret->size) {
+                ret = b;
+            }
+        }
+        return {ret};
+    }
+
+    // The outermost loop sweeps, which requires OpenMP reductions, atomics, or a sequential loop
+    vector<const LoopB*> ret;
+    vector<const LoopB*> ancestors;
+    find_inner_parallel_loops(block, block, ancestors, min_size, ret);
+    if (ret.empty() and openmp_compatible(block)) {
+        ret.push_back(&block);
+    }
+    return ret;
+}
+
+// Returns the scatter instruction if 'block_list' consists of nothing but a single one-dimensional BH_SCATTER
+InstrPtr find_sortable_scatter(const vector<Block> &block_list) {
+    if (block_list.size() != 1 or block_list[0].isInstr()) {
+        return InstrPtr();
+    }
+    InstrPtr ret;
+    for (const InstrPtr &instr: block_list[0].getAllInstr()) {
+        if (bh_opcode_is_system(instr->opcode)) {
+            continue;
+        }
+        if (ret != nullptr or instr->opcode != BH_SCATTER or instr->operand[2].ndim != 1 or
+            bh_is_constant(&instr->operand[1])) {
+            return InstrPtr();
+        }
+        ret = instr;
+    }
+    return ret;
+}
+
+// Writes a BH_SCATTER using sort-and-segment: the iterations are sorted by their destination index such that
+// duplicated indexes become consecutive. Only the last iteration of each segment is written, which makes
+// duplicates deterministic (the last write wins as in a sequential execution) and the writes monotonic.
+void write_sorted_scatter(const SymbolTable &symbols, const bh_instruction &instr, const ConfigParser &config,
+                          stringstream &out) {
+    const bool enable_openmp = config.defaultGet<bool>("compiler_openmp", false);
+    const bh_view &index = instr.operand[2];
+    const int64_t size = index.shape[0];
+    // The destination indexes are bound by the size of the output base, which makes a counting sort
+    // feasible when the output isn't much larger than the number of iterations
+    const int64_t nkeys = instr.operand[0].base->nelem;
+    const bool counting_sort = nkeys <= 8 * size;
+    Scope scope(symbols, nullptr, {}, vector<const bh_view*>{}, vector<const bh_view*>{}, config);
+    stringstream key;
+    scope.getName(index, key);
+    write_array_subscription(scope, index, key);
+
+    spaces(out, 4);
+    out << "// Sort-and-segment scatter\n";
+    spaces(out, 4);
+    out << "struct bh_scatter_pair *pairs = malloc(" << size << " * sizeof(struct bh_scatter_pair));\n";
+    if (counting_sort) { // A stable counting sort, which keeps the iteration order within each segment
+        spaces(out, 4);
+        out << "uint64_t *count = calloc(" << nkeys + 1 << ", sizeof(uint64_t));\n";
+        spaces(out, 4);
+        out << "for(uint64_t i0=0; i0 < " << size << "; ++i0) ++count[" << key.str() << " + 1];\n";
+        spaces(out, 4);
+        out << "for(uint64_t k=1; k < " << nkeys << "; ++k) count[k] += count[k-1];\n";
+        spaces(out, 4);
+        out << "for(uint64_t i0=0; i0 < " << size << "; ++i0) {\n";
+        spaces(out, 8);
+        out << "const uint64_t k = " << key.str() << ";\n";
+        spaces(out, 8);
+        out << "pairs[count[k]].key = k;\n";
+        spaces(out, 8);
+        out << "pairs[count[k]++].pos = i0;\n";
+        spaces(out, 4);
+        out << "}\n";
+        spaces(out, 4);
+        out << "free(count);\n";
+    } else {
+        if (enable_openmp) {
+            spaces(out, 4);
+            out << "#pragma omp parallel for\n";
+        }
+        spaces(out, 4);
+        out << "for(uint64_t i0=0; i0 < " << size << "; ++i0) {\n";
+        spaces(out, 8);
+        out << "pairs[i0].key = " << key.str() << ";\n";
+        spaces(out, 8);
+        out << "pairs[i0].pos = i0;\n";
+        spaces(out, 4);
+        out << "}\n";
+        spaces(out, 4);
+        out << "qsort(pairs, " << size << ", sizeof(struct bh_scatter_pair), bh_scatter_pair_cmp);\n";
+    }
+    if (enable_openmp) {
+        spaces(out, 4);
+        out << "#pragma omp parallel for\n";
+    }
+    spaces(out, 4);
+    out << "for(uint64_t j=0; j < " << size << "; ++j) {\n";
+    spaces(out, 8);
+    out << "if (j+1 == " << size << " || pairs[j].key != pairs[j+1].key) {\n";
+    spaces(out, 12);
+    out << "const uint64_t i0 = pairs[j].pos;\n";
+    spaces(out, 12);
+    write_instr(scope, instr, out);
+    spaces(out, 8);
+    out << "}\n";
+    spaces(out, 4);
+    out << "}\n";
+    spaces(out, 4);
+    out << "free(pairs);\n";
+}
+
+// The alignment (in bytes) of the array pointers that the contiguous fast path assumes
+constexpr int fast_path_alignment = 32;
+
+// Returns the strides of 'view' when it is contiguous in row-major order. Axes of length one
+// gets the stride zero since their iterator is always zero.
+vector<int64_t> contiguous_row_major_strides(const bh_view &view) {
+    vector<int64_t> ret(view.ndim, 0);
+    int64_t stride = 1;
+    for (int64_t i = view.ndim-1; i >= 0; --i) {
+        if (view.shape[i] > 1) {
+            ret[i] = stride;
+            stride *= view.shape[i];
+        }
+    }
+    return ret;
+}
+
+// Returns the size (in bytes) of the last-level cache or zero when unknown
+int64_t last_level_cache_size() {
+    int64_t ret = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    ret = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (ret <= 0) {
+        ret = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    }
+#endif
+    return ret > 0 ? ret : 0;
+}
+
+// Returns the output bases in 'block_list' that should be written using non-temporal stores: bases of at least
+// 'threshold' bytes that the kernel constructs and writes contiguously by element-wise instructions but never reads.
+// For such outputs, the read-for-ownership of each cache line is pure overhead.
+set<bh_base*> find_nontemporal_outputs(const vector<Block> &block_list, const SymbolTable &symbols,
+                                       int64_t threshold) {
+    set<bh_base*> candidates, rejected;
+    for (const Block &block: block_list) {
+        for (const InstrPtr &instr: block.getAllInstr()) {
+            if (bh_opcode_is_system(instr->opcode) or instr->operand.empty()) {
+                continue;
+            }
+            for (size_t i = 1; i < instr->operand.size(); ++i) {
+                if (not bh_is_constant(&instr->operand[i])) {
+                    rejected.insert(instr->operand[i].base);
+                }
+            }
+            const bh_view &out = instr->operand[0];
+            const bh_type type = out.base->type;
+            const bool elementwise = not (bh_opcode_is_sweep(instr->opcode) or instr->opcode == BH_SCATTER or
+                                          instr->opcode == BH_COND_SCATTER);
+            // NB: the stores are done by 'movnti', which only handles 4 and 8 bytes integers
+            const bool storable = not bh_type_is_complex(type) and
+                                  (bh_type_size(type) == 4 or bh_type_size(type) == 8);
+            if (elementwise and storable and instr->constructor and bh_is_contiguous(&out) and
+                bh_base_size(out.base) >= threshold) {
+                candidates.insert(out.base);
+            } else {
+                rejected.insert(out.base);
+            }
+        }
+    }
+    // Only kernel parameters are written to main memory, temporaries are scalar replaced or freed by the kernel
+    const vector<bh_base*> &params = symbols.getParams();
+    set<bh_base*> ret;
+    for (bh_base *base: candidates) {
+        if (not util::exist(rejected, base) and std::find(params.begin(), params.end(), base) != params.end()) {
+            ret.insert(base);
+        }
+    }
+    return ret;
+}
+
+// Writes the macros that implement non-temporal stores and the store fence
+void write_nontemporal_macros(stringstream &out) {
+    out << "#if defined(__clang__)\n";
+    out << "    #define BH_STREAM_STORE4(p, v) __builtin_nontemporal_store((__typeof__(*(p)))(v), (p))\n";
+    out << "    #define BH_STREAM_STORE8(p, v) __builtin_nontemporal_store((__typeof__(*(p)))(v), (p))\n";
+    out << "#elif defined(__GNUC__) && defined(__x86_64__)\n";
+    out << "    #define BH_STREAM_STORE4(p, v) do {__typeof__(*(p)) _v = (v); int _b; "
+           "__builtin_memcpy(&_b, &_v, 4); __builtin_ia32_movnti((int*)(p), _b);} while(0)\n";
+    out << "    #define BH_STREAM_STORE8(p, v) do {__typeof__(*(p)) _v = (v); long long _b; "
+           "__builtin_memcpy(&_b, &_v, 8); __builtin_ia32_movnti64((long long*)(p), _b);} while(0)\n";
+    out << "#else\n";
+    out << "    #define BH_STREAM_STORE4(p, v) (*(p) = (v))\n";
+    out << "    #define BH_STREAM_STORE8(p, v) (*(p) = (v))\n";
+    out << "#endif\n";
+    out << "#if defined(__x86_64__) || defined(__i386__)\n";
+    out << "    #define BH_STREAM_FENCE() __builtin_ia32_sfence()\n";
+    out << "#else\n";
+    out << "    #define BH_STREAM_FENCE()\n";
+    out << "#endif\n";
+}
+
+// The C headers that a kernel needs beside <stdint.h> and <stdbool.h>, which are always included
+struct KernelHeaders {
+    // <stdlib.h> e.g. for malloc() and llabs()
+    bool stdlib = false;
+    // <math.h> for the math functions of double
+    bool math = false;
+    // <tgmath.h>, which makes the math functions type-generic (float and complex)
+    bool tgmath = false;
+    // <complex.h> for the complex types
+    bool complex = false;
+};
+
+// Returns the headers that the instructions in 'block_list' need
+KernelHeaders find_kernel_headers(const vector<Block> &block_list) {
+    KernelHeaders ret;
+    for (const Block &block: block_list) {
+        for (const InstrPtr &instr: block.getAllInstr()) {
+            if (bh_opcode_is_system(instr->opcode)) {
+                continue;
+            }
+            for (size_t i = 0; i < instr->operand.size(); ++i) {
+                const bh_type type = instr->operand_type(i);
+                if (bh_type_is_complex(type)) {
+                    ret.complex = ret.tgmath = ret.math = true;
+                } else if (type == bh_type::FLOAT32) {
+                    ret.tgmath = ret.math = true;
+                } else if (bh_type_is_float(type)) {
+                    ret.math = true;
+                }
+            }
+            // NB: the integer power is written using pow() and the integer absolute using abs() and llabs()
+            if (instr->opcode == BH_POWER) {
+                ret.math = true;
+            } else if (instr->opcode == BH_ABSOLUTE and bh_type_is_signed_integer(instr->operand_type(1))) {
+                ret.stdlib = true;
+            }
+        }
+    }
+    return ret;
+}
+
 void Impl::write_kernel(const vector<Block> &block_list, const SymbolTable &symbols, const ConfigParser &config,
                         const vector<bh_base*> &kernel_temps, stringstream &ss) {
+    // Scatters that might contain duplicated indexes can be written using sort-and-segment
+    InstrPtr sorted_scatter;
+    if (config.defaultGet<bool>("scatter_sort", false)) {
+        sorted_scatter = find_sortable_scatter(block_list);
+    }
+
+    // Large outputs that are only written can bypass the cache using non-temporal stores
+    set<bh_base*> nontemporal_outputs;
+    if (config.defaultGet<bool>("nontemporal_stores", false)) {
+        int64_t threshold = config.defaultGet<int64_t>("nontemporal_threshold", 0);
+        if (threshold <= 0) {
+            threshold = last_level_cache_size();
+        }
+        if (threshold > 0) {
+            nontemporal_outputs = find_nontemporal_outputs(block_list, symbols, threshold);
+        }
+    }
 
-    // Write the need includes
+    // Write the need includes. The type-generic math headers are the most expensive to parse thus they come from
+    // the precompiled preamble of the engine when available, which must be the first include.
+    KernelHeaders headers = find_kernel_headers(block_list);
+    headers.stdlib |= not kernel_temps.empty() or sorted_scatter != nullptr;
+    if (headers.tgmath and not engine.preamble().empty()) {
+        ss << "#include \"" << engine.preamble().string() << "\"\n";
+    }
     ss << "#include <stdint.h>\n";
-    ss << "#include <stdlib.h>\n";
     ss << "#include <stdbool.h>\n";
-    ss << "#include <complex.h>\n";
-    ss << "#include <tgmath.h>\n";
-    ss << "#include <math.h>\n";
+    if (headers.stdlib) {
+        ss << "#include <stdlib.h>\n";
+    }
+    if (headers.tgmath and engine.preamble().empty()) {
+        ss << "#include <complex.h>\n";
+        ss << "#include <tgmath.h>\n";
+    }
+    if (headers.math) {
+        ss << "#include <math.h>\n";
+    }
+    const bool autotune = config.defaultGet<bool>("compiler_openmp", false) and
+                          config.defaultGet<bool>("autotune", false);
+    if (autotune) {
+        ss << "#include <omp.h>\n";
+    }
     if (symbols.useRandom()) { // Write the random function
         ss << "#include <kernel_dependencies/random123_openmp.h>\n";
     }
-    write_c99_dtype_union(ss); // We always need to declare the union of all constant data types
+    write_c99_dtype_union(ss, headers.complex); // We always need to declare the union of all constant data types
     ss << "\n";
-
-    // Write the header of the execute function
-    ss << "void execute";
-    write_kernel_function_arguments(symbols, write_c99_type, ss, nullptr, false);
-
-    // Write the block that makes up the body of 'execute()'
-    ss << "{\n";
-    // Write allocations of the kernel temporaries
-    for(const bh_base* b: kernel_temps) {
-        spaces(ss, 4);
-        ss << write_c99_type(b->type) << " * __restrict__ a" << symbols.baseID(b) << " = malloc(" << bh_base_size(b)
-           << ");\n";
+    if (autotune) {
+        ss << "static int bh_nthreads = 1;\n\n";
+    }
+    if (not nontemporal_outputs.empty()) {
+        write_nontemporal_macros(ss);
+        ss << "\n";
+    }
+    if (sorted_scatter != nullptr) {
+        ss << "struct bh_scatter_pair {uint64_t key; uint64_t pos;};\n";
+        ss << "static int bh_scatter_pair_cmp(const void *a, const void *b) {\n";
+        ss << "    const struct bh_scatter_pair *x = a, *y = b;\n";
+        ss << "    if (x->key != y->key) return x->key < y->key ? -1 : 1;\n";
+        ss << "    return x->pos < y->pos ? -1 : (x->pos > y->pos);\n";
+        ss << "}\n\n";
     }
-    ss << "\n";
 
-    for(const Block &block: block_list) {
-        write_loop_block(symbols, nullptr, block.getLoop(), config, {}, false, write_c99_type, loop_head_writer, ss);
+    // The kernel exposes the ranges of its outermost loop, which the worker pool of the engine executes in parallel,
+    // when it is a single loop nest parallelized at the outermost loop
+    bool ranges = false;
+    if (config.defaultGet<bool>("worker_pool", false) and sorted_scatter == nullptr and kernel_temps.empty() and
+        block_list.size() == 1) {
+        const LoopB &loop = block_list[0].getLoop();
+        const vector<const LoopB*> threaded_blocks = find_parallel_loops(loop, engine.maxThreads(), config);
+        ranges = loop._sweeps.empty() and threaded_blocks.size() == 1 and *threaded_blocks[0] == loop;
     }
 
-    // Write frees of the kernel temporaries
-    ss << "\n";
-    for(const bh_base* b: kernel_temps) {
-        spaces(ss, 4);
-        ss << "free(" << "a" << symbols.baseID(b) << ");\n";
+    // Write the block that makes up the body of 'execute()'. When 'range', the outermost loop sequentially
+    // iterates over [bh_begin, bh_end) since the worker pool runs the ranges in parallel.
+    auto write_body = [&](bool range, stringstream &body) {
+        // Write allocations of the kernel temporaries
+        for(const bh_base* b: kernel_temps) {
+            spaces(body, 4);
+            body << write_c99_type(b->type) << " * __restrict__ a" << symbols.baseID(b) << " = malloc("
+                 << bh_base_size(b) << ");\n";
+        }
+        body << "\n";
+
+        if (sorted_scatter != nullptr) {
+            write_sorted_scatter(symbols, *sorted_scatter, config, body);
+        } else {
+            // The outermost loops marks the non-temporal outputs, which are then visible in all nested scopes
+            auto head_writer = [&nontemporal_outputs, range](const SymbolTable &symbols, Scope &scope,
+                                                             const LoopB &block, const ConfigParser &config,
+                                                             bool loop_is_peeled,
+                                                             const vector<const LoopB *> &threaded_blocks,
+                                                             stringstream &out) {
+                if (block.rank == 0) {
+                    for (const InstrPtr &instr: block.getAllInstr()) {
+                        if (not instr->operand.empty() and util::exist(nontemporal_outputs, instr->operand[0].base)) {
+                            scope.insertNontemporal(instr->operand[0]);
+                        }
+                    }
+                }
+                if (range and block.rank == 0) {
+                    if (block.size > 1) {
+                        write_openmp_header(symbols, scope, block, config, false, out);
+                    }
+                    out << "for(uint64_t i0=bh_begin; i0 < bh_end; ++i0) {\n";
+                } else {
+                    loop_head_writer(symbols, scope, block, config, loop_is_peeled, threaded_blocks, out,
+                                     not nontemporal_outputs.empty());
+                }
+            };
+            auto tail_writer = [&nontemporal_outputs, range](const SymbolTable &symbols, Scope &scope,
+                                                             const LoopB &block, const ConfigParser &config,
+                                                             bool loop_is_peeled,
+                                                             const vector<const LoopB *> &threaded_blocks,
+                                                             stringstream &out) {
+                if (not range and not nontemporal_outputs.empty()) {
+                    loop_tail_writer(block, config, loop_is_peeled, threaded_blocks, out);
+                }
+            };
+            for (const Block &block: block_list) {
+                vector<const LoopB*> threaded_blocks;
+                if (not range) {
+                    threaded_blocks = find_parallel_loops(block.getLoop(), engine.maxThreads(), config);
+                }
+                write_loop_block(symbols, nullptr, block.getLoop(), config, threaded_blocks, false, write_c99_type,
+                                 head_writer, body, tail_writer);
+            }
+            // Non-temporal stores are weakly ordered thus we fence them before returning. The parallel loops fence
+            // the stores of each OpenMP thread (see loop_tail_writer()) and here the calling thread, which also
+            // covers the sequential loops and each worker of a range.
+            if (not nontemporal_outputs.empty()) {
+                spaces(body, 4);
+                body << "BH_STREAM_FENCE();\n";
+            }
+        }
+
+        // Write frees of the kernel temporaries
+        body << "\n";
+        for(const bh_base* b: kernel_temps) {
+            spaces(body, 4);
+            body << "free(" << "a" << symbols.baseID(b) << ");\n";
+        }
+    };
+
+    // The contiguous strides of each offset-and-stride view, which the fast path hard-codes
+    vector<vector<int64_t> > contiguous_strides;
+    bool fast_path = false;
+    if (config.defaultGet<bool>("contiguous_fast_path", false)) {
+        for (const bh_view *view: symbols.offsetStrideViews()) {
+            contiguous_strides.push_back(contiguous_row_major_strides(*view));
+            for (int i = 0; i < view->ndim; ++i) {
+                fast_path |= view->shape[i] > 1;
+            }
+        }
     }
-    ss << "}\n\n";
 
-    // Write the launcher function, which will convert the data_list of void pointers
-    // to typed arrays and call the execute function
-    {
-        ss << "void launcher(void* data_list[], uint64_t offset_strides[], union dtype constants[]) {\n";
+    // Write the execute functions and their launcher. The range variants are named with the "_range" suffix and
+    // take the range of the outermost loop as two extra arguments.
+    for (const bool range: {false, true}) {
+        if (range and not ranges) {
+            continue;
+        }
+        const string suffix = range ? "_range" : "";
+        stringstream body;
+        write_body(range, body);
+
+        // Write the header of the execute function
+        {
+            stringstream args;
+            write_kernel_function_arguments(symbols, write_c99_type, args, nullptr, false);
+            string strargs = args.str();
+            if (range) {
+                strargs = strargs.substr(0, strargs.size() - 1) + (strargs.size() > 2 ? ", " : "") +
+                          "uint64_t bh_begin, uint64_t bh_end)";
+            }
+            ss << "void execute" << suffix << strargs << "{\n" << body.str() << "}\n\n";
+        }
+
+        // Write the fast path, which is 'execute()' specialized for contiguous and aligned arrays.
+        // NB: the offsets are still variables, only the strides are hard-coded
+        if (fast_path) {
+            ss << "void execute_contiguous" << suffix << "(";
+            stringstream stmp;
+            for (const bh_base *b: symbols.getParams()) {
+                stmp << write_c99_type(b->type) << " * __restrict__ a" << symbols.baseID(b) << ", ";
+            }
+            for (const bh_view *view: symbols.offsetStrideViews()) {
+                stmp << "uint64_t vo" << symbols.offsetStridesID(*view) << ", ";
+            }
+            for (const InstrPtr &instr: symbols.constIDs()) {
+                stmp << "const " << write_c99_type(instr->constant.type) << " c" << symbols.constID(*instr) << ", ";
+            }
+            if (range) {
+                stmp << "uint64_t bh_begin, uint64_t bh_end, ";
+            }
+            const string strtmp = stmp.str();
+            ss << strtmp.substr(0, strtmp.size()-2) << ") {\n";
+            for (const bh_base *b: symbols.getParams()) {
+                spaces(ss, 4);
+                ss << "a" << symbols.baseID(b) << " = __builtin_assume_aligned(a" << symbols.baseID(b) << ", "
+                   << fast_path_alignment << ");\n";
+            }
+            for (size_t i = 0; i < symbols.offsetStrideViews().size(); ++i) {
+                const bh_view *view = symbols.offsetStrideViews()[i];
+                for (int j = 0; j < view->ndim; ++j) {
+                    spaces(ss, 4);
+                    ss << "const uint64_t vs" << symbols.offsetStridesID(*view) << "_" << j << " = "
+                       << contiguous_strides[i][j] << ";\n";
+                }
+            }
+            ss << body.str() << "}\n\n";
+        }
+
+        // Write the launcher function, which will convert the data_list of void pointers
+        // to typed arrays and call the execute function
+        if (range) {
+            ss << "const uint64_t launcher_range_size = " << block_list[0].getLoop().size << ";\n";
+            ss << "void launcher_range(void* data_list[], uint64_t offset_strides[], union dtype constants[], "
+                  "uint64_t begin, uint64_t end) {\n";
+        } else {
+            ss << "void launcher(void* data_list[], uint64_t offset_strides[], union dtype constants[], int nthreads, "
+                  "int schedule, int chunk) {\n";
+        }
+        if (autotune and not range) {
+            spaces(ss, 4);
+            ss << "bh_nthreads = nthreads > 0 ? nthreads : omp_get_max_threads();\n";
+            spaces(ss, 4);
+            ss << "omp_set_schedule(schedule > 0 ? (omp_sched_t) schedule : omp_sched_static, chunk);\n";
+        }
         for(size_t i=0; i < symbols.getParams().size(); ++i) {
             spaces(ss, 4);
             bh_base *b = symbols.getParams()[i];
             ss << write_c99_type(b->type) << " *a" << symbols.baseID(b);
             ss << " = data_list[" << i << "];\n";
         }
-        spaces(ss, 4);
-        ss << "execute(";
-        // We create the comma separated list of args and saves it in `stmp`
-        stringstream stmp;
+        // We create the comma separated lists of args and saves them in `sarrays`, `soffsets`, `sstrides`,
+        // `sconsts`, and `srange`. Additionally, `sfast` is the condition for taking the fast path
+        stringstream sarrays, soffsets, sstrides, sconsts, srange, sfast;
         for(size_t i=0; i < symbols.getParams().size(); ++i) {
             bh_base *b = symbols.getParams()[i];
-            stmp << "a" << symbols.baseID(b) << ", ";
+            sarrays << "a" << symbols.baseID(b) << ", ";
+            sfast << "((uintptr_t)a" << symbols.baseID(b) << " % " << fast_path_alignment << ") == 0 && ";
         }
         uint64_t count=0;
-        for (const bh_view *view: symbols.offsetStrideViews()) {
-            stmp << "offset_strides[" << count++ << "], ";
-            for (int i=0; i<view->ndim; ++i) {
-                stmp << "offset_strides[" << count++ << "], ";
+        for (size_t i = 0; i < symbols.offsetStrideViews().size(); ++i) {
+            const bh_view *view = symbols.offsetStrideViews()[i];
+            soffsets << "offset_strides[" << count << "], ";
+            sstrides << "offset_strides[" << count++ << "], ";
+            for (int j = 0; j < view->ndim; ++j) {
+                if (fast_path and view->shape[j] > 1) {
+                    sfast << "offset_strides[" << count << "] == " << contiguous_strides[i][j] << " && ";
+                }
+                sstrides << "offset_strides[" << count++ << "], ";
             }
         }
         if (symbols.constIDs().size() > 0) {
             uint64_t i=0;
             for (auto it = symbols.constIDs().begin(); it != symbols.constIDs().end(); ++it) {
                 const InstrPtr &instr = *it;
-                stmp << "constants[" << i++ << "]." << bh_type_text(instr->constant.type) << ", ";
+                sconsts << "constants[" << i++ << "]." << bh_type_text(instr->constant.type) << ", ";
             }
         }
-        // And then we write `stmp` into `ss` excluding the last comma
-        const string strtmp = stmp.str();
+        if (range) {
+            srange << "begin, end, ";
+        }
+        if (fast_path) {
+            const string fast_cond = sfast.str();
+            const string fast_args = sarrays.str() + soffsets.str() + sconsts.str() + srange.str();
+            spaces(ss, 4);
+            ss << "if (" << fast_cond.substr(0, fast_cond.size()-4) << ") {\n";
+            spaces(ss, 8);
+            ss << "execute_contiguous" << suffix << "(" << fast_args.substr(0, fast_args.size()-2) << ");\n";
+            spaces(ss, 8);
+            ss << "return;\n";
+            spaces(ss, 4);
+            ss << "}\n";
+        }
+        // And then we write the arguments excluding the last comma
+        const string strtmp = sarrays.str() + sstrides.str() + sconsts.str() + srange.str();
+        spaces(ss, 4);
+        ss << "execute" << suffix << "(";
         if (not strtmp.empty()) {
             ss << strtmp.substr(0, strtmp.size()-2);
         }
         ss << ");\n";
-        ss << "}\n";
+        ss << "}\n\n";
     }
 }
 
 void Impl::execute(bh_ir *bhir) {
+    // The extension methods allocate their operands themselves (and single-threaded), thus we allocate
+    // them beforehand such that the engine can place the pages on the NUMA nodes
+    for (bh_instruction &instr: bhir->instr_list) {
+        if (util::exist(extmethods, instr.opcode)) {
+            for (const bh_view &view: instr.operand) {
+                if (not bh_is_constant(&view)) {
+                    engine.allocBase(view.base);
+                }
+            }
+        }
+    }
+
     // Let's handle extension methods
-    util_handle_extmethod(this, bhir, extmethods);
+    util_handle_extmethod(this, bhir, extmethods, gemm_tile);
 
     // And then the regular instructions
-    handle_cpu_execution(*this, bhir, engine, config, stat, fcache);
+    handle_cpu_execution(*this, bhir, engine, config, stat, fcache, pcache);
 }
@@ -77,6 +77,9 @@ bool simd_compatible(const bohrium::jitk::LoopB &block,
         for(const bh_view *view: instr->get_views()) {
             if (scope.isOpenmpAtomic(*view) or scope.isOpenmpCritical(*view))
                 return false;
+            // Rotating registers are loop-carried dependencies
+            if (scope.isRotating(*view))
+                return false;
         }
     }
     return true;
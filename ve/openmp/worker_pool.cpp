@@ -0,0 +1,135 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sched.h>
+#include <pthread.h>
+
+#include "worker_pool.hpp"
+
+using namespace std;
+
+namespace bohrium {
+
+namespace {
+// Tell the CPU that we are spinning
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Returns the CPUs of the process affinity mask
+vector<int> affinity_cpus() {
+    vector<int> ret;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int i = 0; i < CPU_SETSIZE; ++i) {
+            if (CPU_ISSET(i, &set)) {
+                ret.push_back(i);
+            }
+        }
+    }
+    return ret;
+}
+}
+
+WorkerPool::WorkerPool(int nthreads, bool pinning, uint64_t spin_count) : spin_count(spin_count) {
+    const vector<int> cpus = pinning ? affinity_cpus() : vector<int>();
+    for (int id = 1; id < nthreads; ++id) {
+        _threads.emplace_back(&WorkerPool::worker, this, id);
+        // NB: the calling thread uses the first CPU, which we leave unpinned
+        if (not cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[id % cpus.size()], &set);
+            pthread_setaffinity_np(_threads.back().native_handle(), sizeof(set), &set);
+        }
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stop = true;
+        ++_generation;
+    }
+    _wakeup.notify_all();
+    for (thread &t: _threads) {
+        t.join();
+    }
+}
+
+void WorkerPool::runPart(int id) {
+    // Contiguous ranges of about the same size like "schedule(static)" in OpenMP. NB: the workers are not the OpenMP
+    // threads and aren't bound to the same CPUs, thus pages first-touched by the engine might be on another NUMA node
+    const uint64_t nthreads = static_cast<uint64_t>(size());
+    const uint64_t begin = _size * id / nthreads;
+    const uint64_t end = _size * (id + 1) / nthreads;
+    if (begin < end) {
+        (*_task)(begin, end);
+    }
+}
+
+void WorkerPool::worker(int id) {
+    uint64_t seen = 0;
+    while (true) {
+        // Spin for a while and then sleep until the next dispatch
+        uint64_t generation = _generation.load(memory_order_acquire);
+        for (uint64_t i = 0; generation == seen and i < spin_count; ++i) {
+            cpu_relax();
+            generation = _generation.load(memory_order_acquire);
+        }
+        if (generation == seen) {
+            unique_lock<mutex> lock(_mutex);
+            _wakeup.wait(lock, [&] { return _generation.load(memory_order_acquire) != seen; });
+            generation = _generation.load(memory_order_acquire);
+        }
+        seen = generation;
+        if (_stop) {
+            return;
+        }
+        runPart(id);
+        _pending.fetch_sub(1, memory_order_release);
+    }
+}
+
+void WorkerPool::run(uint64_t size, const Task &task) {
+    if (_threads.empty() or size < 2) {
+        task(0, size);
+        return;
+    }
+    _task = &task;
+    _size = size;
+    _pending.store(static_cast<int>(_threads.size()), memory_order_relaxed);
+    {
+        // NB: the lock makes sure that a worker going to sleep doesn't miss the wakeup
+        lock_guard<mutex> lock(_mutex);
+        _generation.fetch_add(1, memory_order_release);
+    }
+    _wakeup.notify_all();
+
+    runPart(0);
+    while (_pending.load(memory_order_acquire) > 0) {
+        cpu_relax();
+    }
+}
+
+} // bohrium
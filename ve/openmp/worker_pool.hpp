@@ -0,0 +1,83 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __BH_VE_OPENMP_WORKER_POOL_HPP
+#define __BH_VE_OPENMP_WORKER_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bohrium {
+
+// A pool of persistent worker threads that spin while waiting for work. Dispatching a parallel loop to the pool
+// is much cheaper than the fork/join of an OpenMP parallel region, which dominates microsecond-scale kernels.
+// The calling thread participates as the first worker.
+class WorkerPool {
+  public:
+    // A task executes the iterations [begin, end)
+    typedef std::function<void(uint64_t begin, uint64_t end)> Task;
+
+  private:
+    std::vector<std::thread> _threads;
+
+    // Each dispatch increments the generation, which wakes up the workers
+    std::atomic<uint64_t> _generation{0};
+    // Number of workers that haven't finished the current dispatch
+    std::atomic<int> _pending{0};
+    std::atomic<bool> _stop{false};
+
+    // The current dispatch
+    const Task *_task = nullptr;
+    uint64_t _size = 0;
+
+    // Number of spins before a waiting worker goes to sleep
+    const uint64_t spin_count;
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+
+    // Execute the part of the current dispatch that belongs to worker 'id'
+    void runPart(int id);
+
+    // The main loop of the worker 'id'
+    void worker(int id);
+
+  public:
+    // Create a pool of 'nthreads' threads including the calling thread. When 'pinning', each worker thread is pinned
+    // to its own CPU of the process affinity mask.
+    WorkerPool(int nthreads, bool pinning, uint64_t spin_count);
+    ~WorkerPool();
+
+    // The number of threads including the calling thread
+    int size() const {
+        return static_cast<int>(_threads.size()) + 1;
+    }
+
+    // Execute 'task' on the iterations [0, size) using a static schedule and return when all of them are done
+    void run(uint64_t size, const Task &task);
+};
+
+} // bohrium
+
+#endif
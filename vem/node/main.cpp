@@ -19,7 +19,11 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <iostream>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <bh_component.hpp>
+#include <bh_util.hpp>
 
 using namespace bohrium;
 using namespace component;
@@ -34,13 +38,113 @@ class Impl : public ComponentImplWithChild {
     void inspect(bh_instruction *instr);
     // Show memory warnings
     bool mem_warn;
+    // Execute only the instructions that synced arrays depend on and defer the rest to the next execution
+    const bool partial_sync;
+    // Concatenate batches without syncs and extension methods with the following batches
+    const bool batching;
+    // The maximum number of concatenated batches, deferred instructions, and seconds to defer them
+    const uint64_t max_batches;
+    const uint64_t max_pending;
+    const double max_pending_age;
+    // The number of batches and the time since the pending instructions were empty
+    uint64_t _pending_batches = 0;
+    chrono::steady_clock::time_point _pending_since;
+    // The deferred instructions
+    vector<bh_instruction> _pending;
+    // Copies of base arrays that the bridge has freed while deferred instructions still access them
+    map<bh_base*, unique_ptr<bh_base> > _clones;
+    // Execute the pending instructions that `is_root` selects and the pending instructions they depend on
+    void execute_slice(const function<bool(const bh_instruction &)> &is_root);
+    // Replace the base arrays that the pending instructions free with copies the VEM owns
+    void clone_freed_bases();
   public:
-    Impl(int stack_level) : ComponentImplWithChild(stack_level) {
+    Impl(int stack_level) : ComponentImplWithChild(stack_level),
+                            partial_sync(config.defaultGet<bool>("partial_sync", false)),
+                            batching(config.defaultGet<bool>("batching", false)),
+                            max_batches(config.defaultGet<uint64_t>("max_batches", 16)),
+                            max_pending(config.defaultGet<uint64_t>("max_pending", 10000)),
+                            max_pending_age(config.defaultGet<double>("max_pending_age", 0.1)) {
         mem_warn = getenv("BH_MEM_WARN") != NULL;
     }
     ~Impl(); // NB: a destructor implementation must exist
     void execute(bh_ir *bhir);
+    void* get_mem_ptr(bh_base &base, bool copy2host, bool force_alloc, bool nullify);
+    void set_mem_ptr(bh_base *base, bool host_ptr, void *mem);
 };
+
+// Returns true when 'instr' accesses 'base'
+bool accesses(const bh_instruction &instr, const bh_base *base) {
+    for (const bh_view &view: instr.operand) {
+        if (not bh_is_constant(&view) and view.base == base) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns true when 'instr' writes its operand 'o'. We do not know which of the operands an extension method writes.
+bool writes(const bh_instruction &instr, size_t o) {
+    return (o == 0 and instr.opcode != BH_SYNC) or instr.opcode > BH_MAX_OPCODE_ID;
+}
+
+// Returns the instructions of 'instr_list' that 'is_root' selects together with the instructions they depend on,
+// which are the earlier instructions that write an array the selected instructions access or access an array the
+// selected instructions write, and the frees that do not depend on the rest. The dependencies are per base array.
+vector<bool> backward_slice(const vector<bh_instruction> &instr_list,
+                            const function<bool(const bh_instruction &)> &is_root) {
+    vector<bool> ret(instr_list.size(), false);
+    // BH_REPEAT and instructions without operands depend on their position in the list
+    for (const bh_instruction &instr: instr_list) {
+        if (instr.opcode == BH_REPEAT or (instr.operand.empty() and instr.opcode != BH_NONE)) {
+            ret.assign(instr_list.size(), true);
+            return ret;
+        }
+    }
+    set<const bh_base *> read, written;
+    for (size_t i = instr_list.size(); i-- > 0;) {
+        const bh_instruction &instr = instr_list[i];
+        bool in_slice = is_root(instr);
+        for (size_t o = 0; o < instr.operand.size() and not in_slice; ++o) {
+            const bh_view &view = instr.operand[o];
+            if (bh_is_constant(&view)) {
+                continue;
+            }
+            in_slice = util::exist(written, view.base) or (writes(instr, o) and util::exist(read, view.base));
+        }
+        if (in_slice) {
+            ret[i] = true;
+            for (size_t o = 0; o < instr.operand.size(); ++o) {
+                const bh_view &view = instr.operand[o];
+                if (not bh_is_constant(&view)) {
+                    if (writes(instr, o)) {
+                        written.insert(view.base);
+                    } else {
+                        read.insert(view.base);
+                    }
+                }
+            }
+        }
+    }
+    // Frees of arrays that no deferred instruction accesses can execute right away, which lets the child contract
+    // temporary arrays in the slice
+    set<const bh_base *> deferred;
+    for (size_t i = 0; i < instr_list.size(); ++i) {
+        const bh_instruction &instr = instr_list[i];
+        if (ret[i]) {
+            continue;
+        }
+        if (instr.opcode == BH_FREE and not util::exist(deferred, instr.operand[0].base)) {
+            ret[i] = true;
+        } else {
+            for (const bh_view &view: instr.operand) {
+                if (not bh_is_constant(&view)) {
+                    deferred.insert(view.base);
+                }
+            }
+        }
+    }
+    return ret;
+}
 } //Unnamed namespace
 
 extern "C" ComponentImpl* create(int stack_level) {
@@ -51,6 +155,7 @@ extern "C" void destroy(ComponentImpl* self) {
 }
 
 Impl::~Impl() {
+    execute_slice([](const bh_instruction &) { return true; });
     if (_allocated_bases.size() > 0)
     {
         long s = (long) _allocated_bases.size();
@@ -93,5 +198,94 @@ void Impl::execute(bh_ir *bhir) {
         for(uint64_t i=0; i < bhir->instr_list.size(); ++i)
             inspect(&bhir->instr_list[i]);
     }
-    child.execute(bhir);
+    if (not (partial_sync or batching)) {
+        child.execute(bhir);
+        return;
+    }
+    // The new instructions follow the deferred instructions
+    if (_pending.empty()) {
+        _pending_batches = 0;
+        _pending_since = chrono::steady_clock::now();
+    }
+    ++_pending_batches;
+    _pending.insert(_pending.end(), bhir->instr_list.begin(), bhir->instr_list.end());
+    bool sync = false, extmethod = false;
+    for (const bh_instruction &instr: bhir->instr_list) {
+        sync = sync or instr.opcode == BH_SYNC;
+        extmethod = extmethod or instr.opcode > BH_MAX_OPCODE_ID;
+    }
+    const double age = chrono::duration<double>(chrono::steady_clock::now() - _pending_since).count();
+    const bool full = _pending_batches >= max_batches or _pending.size() > max_pending or age > max_pending_age;
+    if (extmethod or full or (sync and not partial_sync) or (not sync and not batching)) {
+        execute_slice([](const bh_instruction &) { return true; });
+    } else if (sync) {
+        execute_slice([](const bh_instruction &instr) { return instr.opcode == BH_SYNC; });
+    } else {
+        // We keep the whole batch for the next execution
+        clone_freed_bases();
+    }
+}
+
+void Impl::execute_slice(const function<bool(const bh_instruction &)> &is_root) {
+    if (_pending.empty()) {
+        return;
+    }
+    const vector<bool> in_slice = backward_slice(_pending, is_root);
+    bh_ir bhir;
+    vector<bh_instruction> deferred;
+    set<bh_base *> freed_clones;
+    for (size_t i = 0; i < _pending.size(); ++i) {
+        if (in_slice[i]) {
+            if (_pending[i].opcode == BH_FREE and util::exist(_clones, _pending[i].operand[0].base)) {
+                freed_clones.insert(_pending[i].operand[0].base);
+            }
+            bhir.instr_list.push_back(std::move(_pending[i]));
+        } else {
+            deferred.push_back(std::move(_pending[i]));
+        }
+    }
+    _pending = std::move(deferred);
+    if (not bhir.instr_list.empty()) {
+        child.execute(&bhir);
+    }
+    for (bh_base *base: freed_clones) {
+        _clones.erase(base);
+    }
+    clone_freed_bases();
+}
+
+void Impl::clone_freed_bases() {
+    // The bridge deletes a base array after the execution that frees it
+    map<const bh_base *, bh_base *> renames;
+    for (const bh_instruction &instr: _pending) {
+        bh_base *base = instr.operand.empty() ? nullptr : instr.operand[0].base;
+        if (instr.opcode != BH_FREE or util::exist(_clones, base) or util::exist(renames, base)) {
+            continue;
+        }
+        unique_ptr<bh_base> clone(new bh_base(*base));
+        // Let the child move the data to main memory and forget about the original base array
+        clone->data = child.get_mem_ptr(*base, true, false, true);
+        renames[base] = clone.get();
+        _clones[clone.get()] = std::move(clone);
+    }
+    if (renames.empty()) {
+        return;
+    }
+    for (bh_instruction &instr: _pending) {
+        for (bh_view &view: instr.operand) {
+            if (not bh_is_constant(&view) and util::exist(renames, view.base)) {
+                view.base = renames.at(view.base);
+            }
+        }
+    }
+}
+
+void* Impl::get_mem_ptr(bh_base &base, bool copy2host, bool force_alloc, bool nullify) {
+    execute_slice([&base](const bh_instruction &instr) { return accesses(instr, &base); });
+    return child.get_mem_ptr(base, copy2host, force_alloc, nullify);
+}
+
+void Impl::set_mem_ptr(bh_base *base, bool host_ptr, void *mem) {
+    execute_slice([base](const bh_instruction &instr) { return accesses(instr, base); });
+    child.set_mem_ptr(base, host_ptr, mem);
 }